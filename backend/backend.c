@@ -226,6 +226,10 @@ static struct wlr_backend *attempt_headless_backend(struct wl_event_loop *loop)
 		return NULL;
 	}
 
+	if (env_parse_bool("WLR_HEADLESS_VIRTUAL_CLOCK")) {
+		wlr_headless_backend_set_virtual_clock(backend, true);
+	}
+
 	size_t outputs = parse_outputs_env("WLR_HEADLESS_OUTPUTS");
 	for (size_t i = 0; i < outputs; ++i) {
 		wlr_headless_add_output(backend, 1280, 720);
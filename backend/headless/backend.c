@@ -81,6 +81,13 @@ struct wlr_backend *wlr_headless_backend_create(struct wl_event_loop *loop) {
 	return &backend->backend;
 }
 
+void wlr_headless_backend_set_virtual_clock(struct wlr_backend *wlr_backend,
+		bool enabled) {
+	struct wlr_headless_backend *backend =
+		headless_backend_from_backend(wlr_backend);
+	backend->virtual_clock = enabled;
+}
+
 bool wlr_backend_is_headless(struct wlr_backend *backend) {
 	return backend->impl == &backend_impl;
 }
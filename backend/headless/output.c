@@ -1,11 +1,15 @@
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/types/wlr_output_layer.h>
 #include <wlr/util/log.h>
 #include "backend/headless.h"
 #include "types/wlr_output.h"
+#include "util/time.h"
 
 static const uint32_t SUPPORTED_OUTPUT_STATE =
 	WLR_OUTPUT_STATE_BACKEND_OPTIONAL |
@@ -28,7 +32,94 @@ static void output_update_refresh(struct wlr_headless_output *output,
 		refresh = HEADLESS_DEFAULT_REFRESH;
 	}
 
-	output->frame_delay = 1000000 / refresh;
+	output->refresh_nsec = (int64_t)1000000 * 1000000 / refresh;
+}
+
+static void handle_virtual_vblank(void *data);
+
+static void schedule_vblank(struct wlr_headless_output *output) {
+	if (output->vblank_armed) {
+		return;
+	}
+
+	if (output->backend->virtual_clock) {
+		// Time only moves forward when a frame completes
+		output->next_vblank_nsec = output->last_vblank_nsec + output->refresh_nsec;
+		output->virtual_vblank_idle = wl_event_loop_add_idle(
+			output->backend->event_loop, handle_virtual_vblank, output);
+		if (output->virtual_vblank_idle == NULL) {
+			wlr_log(WLR_ERROR, "Failed to add idle event source");
+			return;
+		}
+		output->vblank_armed = true;
+		return;
+	}
+
+	// Pick the first vblank after now, keeping the phase of the last one so
+	// that late commits don't make the schedule drift
+	int64_t now = get_current_time_nsec();
+	int64_t elapsed = now - output->last_vblank_nsec;
+	int64_t periods = elapsed > 0 ? elapsed / output->refresh_nsec + 1 : 1;
+	output->next_vblank_nsec = output->last_vblank_nsec + periods * output->refresh_nsec;
+
+	struct itimerspec spec = {0};
+	timespec_from_nsec(&spec.it_value, output->next_vblank_nsec);
+	if (timerfd_settime(output->vblank_fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0) {
+		wlr_log_errno(WLR_ERROR, "timerfd_settime failed");
+		return;
+	}
+	output->vblank_armed = true;
+}
+
+static void output_vblank(struct wlr_headless_output *output) {
+	output->vblank_armed = false;
+	output->vblank_seq += (output->next_vblank_nsec - output->last_vblank_nsec) /
+		output->refresh_nsec;
+	output->last_vblank_nsec = output->next_vblank_nsec;
+
+	if (output->present_pending) {
+		output->present_pending = false;
+
+		struct wlr_output_event_present present_event = {
+			.presented = true,
+			.seq = output->vblank_seq,
+			.refresh = output->refresh_nsec,
+			.flags = WLR_OUTPUT_PRESENT_VSYNC,
+		};
+		timespec_from_nsec(&present_event.when, output->last_vblank_nsec);
+		if (!output->backend->virtual_clock) {
+			present_event.flags |= WLR_OUTPUT_PRESENT_HW_CLOCK;
+		}
+		// All commits since the last vblank hit the screen at once
+		uint32_t first = output->present_seq_first, last = output->present_seq_last;
+		for (uint32_t seq = first; seq != last + 1; seq++) {
+			present_event.commit_seq = seq;
+			wlr_output_send_present(&output->wlr_output, &present_event);
+		}
+	}
+
+	wlr_output_send_frame(&output->wlr_output);
+}
+
+static void handle_virtual_vblank(void *data) {
+	struct wlr_headless_output *output = data;
+	output->virtual_vblank_idle = NULL;
+	output_vblank(output);
+}
+
+static int handle_vblank_timer(int fd, uint32_t mask, void *data) {
+	struct wlr_headless_output *output = data;
+
+	uint64_t expirations;
+	if (read(fd, &expirations, sizeof(expirations)) < 0) {
+		if (errno != EAGAIN) {
+			wlr_log_errno(WLR_ERROR, "Failed to read vblank timer");
+		}
+		return 0;
+	}
+
+	output_vblank(output);
+	return 0;
 }
 
 static bool output_test(struct wlr_output *wlr_output,
@@ -67,13 +158,14 @@ static bool output_commit(struct wlr_output *wlr_output,
 	}
 
 	if (output_pending_enabled(wlr_output, state)) {
-		struct wlr_output_event_present present_event = {
-			.commit_seq = wlr_output->commit_seq + 1,
-			.presented = true,
-		};
-		output_defer_present(wlr_output, present_event);
+		uint32_t commit_seq = wlr_output->commit_seq + 1;
+		if (!output->present_pending) {
+			output->present_seq_first = commit_seq;
+			output->present_pending = true;
+		}
+		output->present_seq_last = commit_seq;
 
-		wl_event_source_timer_update(output->frame_timer, output->frame_delay);
+		schedule_vblank(output);
 	}
 
 	return true;
@@ -94,7 +186,11 @@ static void output_destroy(struct wlr_output *wlr_output) {
 	wlr_output_finish(wlr_output);
 
 	wl_list_remove(&output->link);
-	wl_event_source_remove(output->frame_timer);
+	wl_event_source_remove(output->vblank_source);
+	if (output->virtual_vblank_idle != NULL) {
+		wl_event_source_remove(output->virtual_vblank_idle);
+	}
+	close(output->vblank_fd);
 	free(output);
 }
 
@@ -110,12 +206,6 @@ bool wlr_output_is_headless(struct wlr_output *wlr_output) {
 	return wlr_output->impl == &output_impl;
 }
 
-static int signal_frame(void *data) {
-	struct wlr_headless_output *output = data;
-	wlr_output_send_frame(&output->wlr_output);
-	return 0;
-}
-
 struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 		unsigned int width, unsigned int height) {
 	struct wlr_headless_backend *backend =
@@ -127,6 +217,22 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 		return NULL;
 	}
 	output->backend = backend;
+
+	output->vblank_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	if (output->vblank_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to create vblank timer");
+		free(output);
+		return NULL;
+	}
+	output->vblank_source = wl_event_loop_add_fd(backend->event_loop,
+		output->vblank_fd, WL_EVENT_READABLE, handle_vblank_timer, output);
+	if (output->vblank_source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add vblank timer event source");
+		close(output->vblank_fd);
+		free(output);
+		return NULL;
+	}
+
 	struct wlr_output *wlr_output = &output->wlr_output;
 
 	struct wlr_output_state state;
@@ -137,6 +243,7 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 	wlr_output_state_finish(&state);
 
 	output_update_refresh(output, 0);
+	output->last_vblank_nsec = get_current_time_nsec();
 
 	size_t output_num = ++last_output_num;
 
@@ -148,8 +255,6 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 	snprintf(description, sizeof(description), "Headless output %zu", output_num);
 	wlr_output_set_description(wlr_output, description);
 
-	output->frame_timer = wl_event_loop_add_timer(backend->event_loop, signal_frame, output);
-
 	wl_list_insert(&backend->outputs, &output->link);
 
 	if (backend->started) {
@@ -22,6 +22,9 @@
 #include "util/time.h"
 #include "types/wlr_output.h"
 
+// Past this many damage rectangles, send the damage extents instead
+#define MAX_DAMAGE_RECTS 64
+
 static const uint32_t SUPPORTED_OUTPUT_STATE =
 	WLR_OUTPUT_STATE_BACKEND_OPTIONAL |
 	WLR_OUTPUT_STATE_BUFFER |
@@ -345,18 +348,21 @@ static bool output_commit_buffer(struct wlr_x11_output *output,
 		goto error;
 	}
 
+	// Only the update region is copied by the X server, so keep it tight
 	xcb_xfixes_region_t region = XCB_NONE;
+	uint64_t area = (uint64_t)buffer->width * buffer->height;
 	if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
 		pixman_region32_union(&output->exposed, &output->exposed, &state->damage);
 
 		int rects_len = 0;
 		const pixman_box32_t *rects = pixman_region32_rectangles(&output->exposed, &rects_len);
-
-		xcb_rectangle_t *xcb_rects = calloc(rects_len, sizeof(xcb_rectangle_t));
-		if (!xcb_rects) {
-			goto error;
+		if (rects_len > MAX_DAMAGE_RECTS) {
+			rects = pixman_region32_extents(&output->exposed);
+			rects_len = 1;
 		}
 
+		xcb_rectangle_t xcb_rects[MAX_DAMAGE_RECTS];
+		area = 0;
 		for (int i = 0; i < rects_len; i++) {
 			const pixman_box32_t *box = &rects[i];
 			xcb_rects[i] = (struct xcb_rectangle_t){
@@ -365,17 +371,20 @@ static bool output_commit_buffer(struct wlr_x11_output *output,
 				.width = box->x2 - box->x1,
 				.height = box->y2 - box->y1,
 			};
+			area += (uint64_t)xcb_rects[i].width * xcb_rects[i].height;
 		}
 
 		region = xcb_generate_id(x11->xcb);
 		xcb_xfixes_create_region(x11->xcb, region, rects_len, xcb_rects);
-
-		free(xcb_rects);
 	}
 
 	pixman_region32_clear(&output->exposed);
 
 	uint32_t serial = output->wlr_output.commit_seq;
+	output->frame_stats.serial = serial;
+	output->frame_stats.commit_nsec = get_current_time_nsec();
+	output->frame_stats.bytes = area * x11->x11_format->bpp / 8;
+
 	uint32_t options = 0;
 	uint64_t target_msc = output->last_msc ? output->last_msc + 1 : 0;
 	xcb_present_pixmap(x11->xcb, output->win, x11_buffer->pixmap, serial,
@@ -770,6 +779,17 @@ void handle_x11_present_event(struct wlr_x11_backend *x11,
 
 		output->last_msc = complete_notify->msc;
 
+		if (complete_notify->serial == output->frame_stats.serial &&
+				complete_notify->kind == XCB_PRESENT_COMPLETE_KIND_PIXMAP &&
+				wlr_log_get_verbosity() >= WLR_DEBUG) {
+			int64_t latency_nsec = (int64_t)complete_notify->ust * 1000 -
+				output->frame_stats.commit_nsec;
+			wlr_log(WLR_DEBUG, "Output %s frame %"PRIu32": updated %"PRIu64" bytes, "
+				"presented after %.3f ms", output->wlr_output.name,
+				complete_notify->serial, output->frame_stats.bytes,
+				(double)latency_nsec / 1000000);
+		}
+
 		uint32_t flags = 0;
 		if (complete_notify->mode == XCB_PRESENT_COMPLETE_MODE_FLIP) {
 			flags |= WLR_OUTPUT_PRESENT_ZERO_COPY;
@@ -7,6 +7,11 @@
 
 #include "config.h"
 
+struct flui_config config = {
+	.output_scale = 1.0f,
+	.pointer_coalesce_ms = 0,
+};
+
 void load_config() {
 	const char *home = getenv("HOME");
 	if (home == NULL) {
@@ -50,8 +55,25 @@ void load_config() {
 				value++;
 			}
 
+			/* Keyboard settings are picked up by the keymap (and its cache key) */
 			if (!strcmp(key, "keyboard_layout")) {
 				setenv("XKB_DEFAULT_LAYOUT", value, true);
+			} else if (!strcmp(key, "keyboard_variant")) {
+				setenv("XKB_DEFAULT_VARIANT", value, true);
+			} else if (!strcmp(key, "keyboard_model")) {
+				setenv("XKB_DEFAULT_MODEL", value, true);
+			} else if (!strcmp(key, "keyboard_options")) {
+				setenv("XKB_DEFAULT_OPTIONS", value, true);
+			} else if (!strcmp(key, "output_scale")) {
+				float scale = strtof(value, NULL);
+				if (scale > 0) {
+					config.output_scale = scale;
+				}
+			} else if (!strcmp(key, "pointer_coalesce_ms")) {
+				int ms = atoi(value);
+				if (ms >= 0) {
+					config.pointer_coalesce_ms = ms;
+				}
 			}
 		}
 		free(vmem);
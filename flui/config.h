@@ -1,6 +1,14 @@
 #ifndef __flui_config_h
 #define __flui_config_h
 
+struct flui_config {
+	float output_scale;
+	/* Coalesce pointer motion for up to this many ms, 0 disables it */
+	int pointer_coalesce_ms;
+};
+
+extern struct flui_config config;
+
 void load_config();
 
 #endif
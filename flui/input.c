@@ -1,8 +1,11 @@
 #include <stdlib.h>
 #include <xkbcommon/xkbcommon.h>
 
+#include "config.h"
 #include "input.h"
+#include "keymap.h"
 #include "layout.h"
+#include "output.h"
 #include "server.h"
 
 /* Handle modifier keys, e.g Alt, Ctrl, Shift */
@@ -88,32 +91,114 @@ void keyboard_handle_destroy(struct wl_listener *listener, void *data) {
 	free(keyboard);
 }
 
+/* Listen for key and modifier events of a keyboard */
+static void keyboard_add_listeners(struct flui_keyboard *keyboard) {
+	keyboard->modifiers.notify = keyboard_handle_modifiers;
+	wl_signal_add(&keyboard->wlr_keyboard->events.modifiers, &keyboard->modifiers);
+	keyboard->key.notify = keyboard_handle_key;
+	wl_signal_add(&keyboard->wlr_keyboard->events.key, &keyboard->key);
+}
+
+/* Compile the keymap once and set up the keyboard group sharing it */
+bool server_setup_keyboards(struct flui_server *server) {
+	/* Default layout loaded from environment variable XKB_DEFAULT_LAYOUT */
+	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	if (context == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create xkb context");
+		return false;
+	}
+	server->keymap = load_keymap(context);
+	xkb_context_unref(context);
+	if (server->keymap == NULL) {
+		wlr_log(WLR_ERROR, "Failed to compile keymap");
+		return false;
+	}
+
+	/* Keyboards with the same keymap are merged into one group keyboard */
+	server->keyboard_group = wlr_keyboard_group_create();
+	if (server->keyboard_group == NULL) {
+		xkb_keymap_unref(server->keymap);
+		server->keymap = NULL;
+		return false;
+	}
+	struct wlr_keyboard *group_keyboard = &server->keyboard_group->keyboard;
+	wlr_keyboard_set_keymap(group_keyboard, server->keymap);
+	wlr_keyboard_set_repeat_info(group_keyboard, 25, 600);
+
+	struct flui_keyboard *keyboard = calloc(1, sizeof(*keyboard));
+	if (keyboard == NULL) {
+		wlr_keyboard_group_destroy(server->keyboard_group);
+		server->keyboard_group = NULL;
+		xkb_keymap_unref(server->keymap);
+		server->keymap = NULL;
+		return false;
+	}
+	keyboard->server = server;
+	keyboard->wlr_keyboard = group_keyboard;
+	keyboard_add_listeners(keyboard);
+	server->group_keyboard = keyboard;
+	return true;
+}
+
+/* Destroy the keyboard group and the shared keymap */
+void server_cleanup_keyboards(struct flui_server *server) {
+	if (server->group_keyboard) {
+		wl_list_remove(&server->group_keyboard->modifiers.link);
+		wl_list_remove(&server->group_keyboard->key.link);
+		free(server->group_keyboard);
+		server->group_keyboard = NULL;
+	}
+	if (server->keyboard_group) {
+		wlr_keyboard_group_destroy(server->keyboard_group);
+		server->keyboard_group = NULL;
+	}
+	xkb_keymap_unref(server->keymap);
+	server->keymap = NULL;
+}
+
 /* Handle new keyboards */
 static void server_new_keyboard(struct flui_server *server, struct wlr_input_device *device) {
 	struct wlr_keyboard *wlr_keyboard = wlr_keyboard_from_input_device(device);
 
 	struct flui_keyboard *keyboard = calloc(1, sizeof(*keyboard));
+	if (keyboard == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate keyboard");
+		return;
+	}
 	keyboard->server = server;
 	keyboard->wlr_keyboard = wlr_keyboard;
 
-	/* Assign keymap (default loaded from environment variable XKB_DEFAULT_LAYOUT) */
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	struct xkb_keymap *keymap = xkb_keymap_new_from_names(context, NULL, XKB_KEYMAP_COMPILE_NO_FLAGS);
-
-	wlr_keyboard_set_keymap(wlr_keyboard, keymap);
-	xkb_keymap_unref(keymap);
-	xkb_context_unref(context);
+	if (server->keymap != NULL) {
+		/* Assign the shared keymap, its serialized form is shared as well */
+		wlr_keyboard_set_keymap(wlr_keyboard, server->keymap);
+	} else {
+		/* No shared keymap, compile one for this device from the environment */
+		struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+		struct xkb_keymap *keymap = context != NULL ?
+			xkb_keymap_new_from_names(context, NULL, XKB_KEYMAP_COMPILE_NO_FLAGS) : NULL;
+		if (keymap != NULL) {
+			wlr_keyboard_set_keymap(wlr_keyboard, keymap);
+		} else {
+			wlr_log(WLR_ERROR, "Failed to compile keymap for %s", device->name);
+		}
+		xkb_keymap_unref(keymap);
+		xkb_context_unref(context);
+	}
 	wlr_keyboard_set_repeat_info(wlr_keyboard, 25, 600);
 
-	/* Set up listeners for keyboard events */
-	keyboard->modifiers.notify = keyboard_handle_modifiers;
-	wl_signal_add(&wlr_keyboard->events.modifiers, &keyboard->modifiers);
-	keyboard->key.notify = keyboard_handle_key;
-	wl_signal_add(&wlr_keyboard->events.key, &keyboard->key);
 	keyboard->destroy.notify = keyboard_handle_destroy;
 	wl_signal_add(&device->events.destroy, &keyboard->destroy);
 
-	wlr_seat_set_keyboard(server->seat, keyboard->wlr_keyboard);
+	if (server->keyboard_group != NULL &&
+			wlr_keyboard_group_add_keyboard(server->keyboard_group, wlr_keyboard)) {
+		/* Key and modifier events arrive through the group keyboard */
+		wl_list_init(&keyboard->modifiers.link);
+		wl_list_init(&keyboard->key.link);
+		wlr_seat_set_keyboard(server->seat, &server->keyboard_group->keyboard);
+	} else {
+		keyboard_add_listeners(keyboard);
+		wlr_seat_set_keyboard(server->seat, keyboard->wlr_keyboard);
+	}
 
 	/* Add the keyboard to the server's list of keyboards */
 	wl_list_insert(&server->keyboards, &keyboard->link);
@@ -168,6 +253,7 @@ void seat_request_set_selection(struct wl_listener *listener, void *data) {
 
 /* Reset the cursor mode to passthrough */
 void reset_cursor_mode(struct flui_server *server) {
+	apply_pending_move(server);
 	server->cursor_mode = FLUI_CURSOR_PASSTHROUGH;
 	server->grabbed_toplevel = NULL;
 }
@@ -194,10 +280,30 @@ static struct flui_toplevel *desktop_toplevel_at(struct flui_server *server, dou
 	return tree->node.data;
 }
 
-/* Move grabbed window */
+/* Move grabbed window to the last position recorded since the previous frame */
+void apply_pending_move(struct flui_server *server) {
+	if (!server->move_pending) {
+		return;
+	}
+	server->move_pending = false;
+	if (server->grabbed_toplevel != NULL) {
+		wlr_scene_node_set_position(&server->grabbed_toplevel->scene_tree->node, server->move_x, server->move_y);
+	}
+}
+
+/* Move grabbed window, the scene is only updated once per output frame */
 static void process_cursor_move(struct flui_server *server) {
-	struct flui_toplevel *toplevel = server->grabbed_toplevel;
-	wlr_scene_node_set_position(&toplevel->scene_tree->node, server->cursor->x - server->grab_x, server->cursor->y - server->grab_y);
+	server->move_x = server->cursor->x - server->grab_x;
+	server->move_y = server->cursor->y - server->grab_y;
+	if (server->move_pending) {
+		return;
+	}
+	server->move_pending = true;
+
+	struct flui_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		wlr_output_schedule_frame(output->wlr_output);
+	}
 }
 
 /* Resize grabbed window */
@@ -233,12 +339,9 @@ static void process_cursor_resize(struct flui_server *server) {
 		}
 	}
 
-	struct wlr_box *geo_box = &toplevel->xdg_toplevel->base->geometry;
-	wlr_scene_node_set_position(&toplevel->scene_tree->node, new_left - geo_box->x, new_top - geo_box->y);
-
 	int new_width = new_right - new_left;
 	int new_height = new_bottom - new_top;
-	wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, new_width, new_height);
+	request_toplevel_size(toplevel, new_left, new_top, new_width, new_height);
 }
 
 /* Process moving the cursor */
@@ -269,6 +372,55 @@ static void process_cursor_motion(struct flui_server *server, uint32_t time) {
 	}
 }
 
+/* Coalesce motion unless disabled or the focused client asks for low latency */
+static bool should_coalesce_motion(struct flui_server *server) {
+	if (config.pointer_coalesce_ms <= 0 || server->cursor_mode != FLUI_CURSOR_PASSTHROUGH) {
+		return false;
+	}
+	struct wlr_surface *focus = server->seat->pointer_state.focused_surface;
+	return focus == NULL || wlr_surface_get_content_type_v1(server->content_type, focus) != WP_CONTENT_TYPE_V1_TYPE_GAME;
+}
+
+/* Send relative motion to clients, e.g. games locking the pointer */
+static void send_relative_motion(struct flui_server *server, uint32_t time, double dx, double dy, double unaccel_dx, double unaccel_dy) {
+	if (dx == 0 && dy == 0 && unaccel_dx == 0 && unaccel_dy == 0) {
+		return;
+	}
+	wlr_relative_pointer_manager_v1_send_relative_motion(server->relative_pointer, server->seat, (uint64_t)time * 1000, dx, dy, unaccel_dx, unaccel_dy);
+}
+
+/* Send the motion accumulated since the last flush as a single event */
+void flush_pointer_motion(struct flui_server *server) {
+	if (!server->motion_pending) {
+		return;
+	}
+	server->motion_pending = false;
+	wl_event_source_timer_update(server->motion_timer, 0);
+
+	/* Deltas are summed, not dropped, so relative motion keeps full resolution */
+	send_relative_motion(server, server->motion_time, server->motion_dx, server->motion_dy, server->motion_unaccel_dx, server->motion_unaccel_dy);
+	server->motion_dx = server->motion_dy = 0;
+	server->motion_unaccel_dx = server->motion_unaccel_dy = 0;
+
+	process_cursor_motion(server, server->motion_time);
+	wlr_seat_pointer_notify_frame(server->seat);
+}
+
+/* Deliver coalesced motion once the deadline passes without an output frame */
+int server_motion_timer(void *data) {
+	struct flui_server *server = data;
+	flush_pointer_motion(server);
+	return 0;
+}
+
+static void queue_pointer_motion(struct flui_server *server, uint32_t time) {
+	server->motion_time = time;
+	if (!server->motion_pending) {
+		server->motion_pending = true;
+		wl_event_source_timer_update(server->motion_timer, config.pointer_coalesce_ms);
+	}
+}
+
 /* Handle relative (delta) pointer movement */
 void server_cursor_motion(struct wl_listener *listener, void *data) {
 	struct flui_server *server =
@@ -276,6 +428,16 @@ void server_cursor_motion(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_motion_event *event = data;
 	/* Move cursor */
 	wlr_cursor_move(server->cursor, &event->pointer->base, event->delta_x, event->delta_y);
+	if (should_coalesce_motion(server)) {
+		server->motion_dx += event->delta_x;
+		server->motion_dy += event->delta_y;
+		server->motion_unaccel_dx += event->unaccel_dx;
+		server->motion_unaccel_dy += event->unaccel_dy;
+		queue_pointer_motion(server, event->time_msec);
+		return;
+	}
+	flush_pointer_motion(server);
+	send_relative_motion(server, event->time_msec, event->delta_x, event->delta_y, event->unaccel_dx, event->unaccel_dy);
 	process_cursor_motion(server, event->time_msec);
 }
 
@@ -285,6 +447,11 @@ void server_cursor_motion_absolute(struct wl_listener *listener, void *data) {
 	wl_container_of(listener, server, cursor_motion_absolute);
 	struct wlr_pointer_motion_absolute_event *event = data;
 	wlr_cursor_warp_absolute(server->cursor, &event->pointer->base, event->x, event->y);
+	if (should_coalesce_motion(server)) {
+		queue_pointer_motion(server, event->time_msec);
+		return;
+	}
+	flush_pointer_motion(server);
 	process_cursor_motion(server, event->time_msec);
 }
 
@@ -292,6 +459,8 @@ void server_cursor_motion_absolute(struct wl_listener *listener, void *data) {
 void server_cursor_button(struct wl_listener *listener, void *data) {
 	struct flui_server *server = wl_container_of(listener, server, cursor_button);
 	struct wlr_pointer_button_event *event = data;
+	/* Clients must see the button at the current position */
+	flush_pointer_motion(server);
 	/* Notify focused client of button press */
 	wlr_seat_pointer_notify_button(server->seat, event->time_msec, event->button, event->state);
 	if (event->state == WL_POINTER_BUTTON_STATE_RELEASED) {
@@ -314,6 +483,7 @@ void server_cursor_axis(struct wl_listener *listener, void *data) {
 	struct flui_server *server =
 	wl_container_of(listener, server, cursor_axis);
 	struct wlr_pointer_axis_event *event = data;
+	flush_pointer_motion(server);
 	/* Notify clients */
 	wlr_seat_pointer_notify_axis(server->seat, event->time_msec, event->orientation, event->delta, event->delta_discrete, event->source, event->relative_direction);
 }
@@ -322,6 +492,10 @@ void server_cursor_axis(struct wl_listener *listener, void *data) {
 void server_cursor_frame(struct wl_listener *listener, void *data) {
 	struct flui_server *server =
 	wl_container_of(listener, server, cursor_frame);
+	/* Coalesced motion gets its frame when it is flushed */
+	if (server->motion_pending) {
+		return;
+	}
 	/* Notify clients */
 	wlr_seat_pointer_notify_frame(server->seat);
 }
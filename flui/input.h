@@ -44,14 +44,19 @@ void keyboard_handle_modifiers(struct wl_listener *listener, void *data);
 bool handle_keybinding(struct flui_server *server, xkb_keysym_t sym);
 void keyboard_handle_key(struct wl_listener *listener, void *data);
 void keyboard_handle_destroy(struct wl_listener *listener, void *data);
+bool server_setup_keyboards(struct flui_server *server);
+void server_cleanup_keyboards(struct flui_server *server);
 void server_new_input(struct wl_listener *listener, void *data);
 void seat_request_cursor(struct wl_listener *listener, void *data);
 void seat_request_set_selection(struct wl_listener *listener, void *data);
 void reset_cursor_mode(struct flui_server *server);
+void apply_pending_move(struct flui_server *server);
 void server_cursor_motion(struct wl_listener *listener, void *data);
 void server_cursor_motion_absolute(struct wl_listener *listener, void *data);
 void server_cursor_button(struct wl_listener *listener, void *data);
 void server_cursor_axis(struct wl_listener *listener, void *data);
 void server_cursor_frame(struct wl_listener *listener, void *data);
+void flush_pointer_motion(struct flui_server *server);
+int server_motion_timer(void *data);
 
 #endif
@@ -0,0 +1,244 @@
+#include <fcntl.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+
+#include "keymap.h"
+#include "util/file.h"
+#include "util/hash.h"
+
+#define XKB_DEFAULT_CONFIG_ROOT "/usr/share/X11/xkb"
+#define XKB_DEFAULT_EXTRA_PATH "/etc/xkb"
+#define XKB_MAX_DIR_DEPTH 8
+
+/* Directories whose contents make up a compiled keymap */
+static const char *xkb_data_dirs[] = {
+	"/rules", "/keycodes", "/types", "/compat", "/symbols",
+};
+
+struct xkb_data_hash {
+	uint64_t hash;
+	bool truncated;
+};
+
+static double elapsed_ms(const struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static const char *env_or_empty(const char *name) {
+	const char *value = getenv(name);
+	return value ? value : "";
+}
+
+/* $HOME, the same way libxkbcommon looks it up */
+static const char *get_home(void) {
+	const char *home = getenv("HOME");
+	return home != NULL && *home != '\0' ? home : NULL;
+}
+
+/* Hash the path, size and modification time of everything below dir */
+static void hash_xkb_dir(struct xkb_data_hash *data, const char *dir, int depth) {
+	DIR *d = opendir(dir);
+	if (d == NULL) {
+		return;
+	}
+
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL) {
+		if (ent->d_name[0] == '.') {
+			continue;
+		}
+
+		char path[PATH_MAX];
+		int n = snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+		if (n < 0 || (size_t)n >= sizeof(path)) {
+			data->truncated = true;
+			continue;
+		}
+		struct stat st;
+		if (stat(path, &st) != 0) {
+			continue;
+		}
+
+		int64_t values[] = { st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_size };
+		data->hash = hash_fnv1a(data->hash, path, n);
+		data->hash = hash_fnv1a(data->hash, values, sizeof(values));
+		if (S_ISDIR(st.st_mode) && depth < XKB_MAX_DIR_DEPTH) {
+			hash_xkb_dir(data, path, depth + 1);
+		}
+	}
+	closedir(d);
+}
+
+/* Add the xkb include root made of prefix and suffix to the hash */
+static void hash_xkb_root(struct xkb_data_hash *data, const char *prefix, const char *suffix) {
+	char root[PATH_MAX];
+	int n = snprintf(root, sizeof(root), "%s%s", prefix, suffix);
+	if (n < 0 || (size_t)n >= sizeof(root)) {
+		data->truncated = true;
+		return;
+	}
+	for (size_t i = 0; i < sizeof(xkb_data_dirs) / sizeof(xkb_data_dirs[0]); i++) {
+		char path[PATH_MAX];
+		n = snprintf(path, sizeof(path), "%s%s", root, xkb_data_dirs[i]);
+		if (n < 0 || (size_t)n >= sizeof(path)) {
+			data->truncated = true;
+			continue;
+		}
+		data->hash = hash_fnv1a(data->hash, path, n);
+		hash_xkb_dir(data, path, 0);
+	}
+}
+
+/*
+ * Hash of the xkb data used to compile keymaps, covering the same include
+ * roots libxkbcommon searches. Any edit below them invalidates the cache.
+ */
+static bool xkb_data_hash(uint64_t *hash) {
+	struct xkb_data_hash data = { .hash = HASH_FNV1A_INIT };
+
+	const char *config_home = getenv("XDG_CONFIG_HOME");
+	const char *home = get_home();
+	if (config_home != NULL && *config_home != '\0') {
+		hash_xkb_root(&data, config_home, "/xkb");
+	} else if (home != NULL) {
+		hash_xkb_root(&data, home, "/.config/xkb");
+	}
+	if (home != NULL) {
+		hash_xkb_root(&data, home, "/.xkb");
+	}
+
+	const char *extra = getenv("XKB_CONFIG_EXTRA_PATH");
+	if (extra == NULL || *extra == '\0') {
+		extra = XKB_DEFAULT_EXTRA_PATH;
+	}
+	hash_xkb_root(&data, extra, "");
+
+	const char *root = getenv("XKB_CONFIG_ROOT");
+	if (root == NULL || *root == '\0') {
+		root = XKB_DEFAULT_CONFIG_ROOT;
+	}
+	hash_xkb_root(&data, root, "");
+
+	*hash = data.hash;
+	return !data.truncated;
+}
+
+/* Cache key made of the RMLVO names (taken from XKB_DEFAULT_*, which the config sets) and data hash */
+static bool get_cache_key(char *key, size_t size) {
+	uint64_t data_hash;
+	if (!xkb_data_hash(&data_hash)) {
+		return false;
+	}
+	int n = snprintf(key, size, "%s\n%s\n%s\n%s\n%s\n%016" PRIx64,
+		env_or_empty("XKB_DEFAULT_RULES"), env_or_empty("XKB_DEFAULT_MODEL"),
+		env_or_empty("XKB_DEFAULT_LAYOUT"), env_or_empty("XKB_DEFAULT_VARIANT"),
+		env_or_empty("XKB_DEFAULT_OPTIONS"), data_hash);
+	return n > 0 && (size_t)n < size;
+}
+
+/* Cache files live in $XDG_CACHE_HOME/flui, or ~/.cache/flui */
+static bool get_cache_path(char *path, size_t size, const char *key) {
+	/* The key hash only names the file, the key itself is stored inside */
+	uint64_t key_hash = hash_fnv1a(HASH_FNV1A_INIT, key, strlen(key));
+
+	int n;
+	const char *cache_home = getenv("XDG_CACHE_HOME");
+	const char *home = get_home();
+	if (cache_home != NULL && *cache_home != '\0') {
+		n = snprintf(path, size, "%s/flui/keymap-%016" PRIx64 ".xkb", cache_home, key_hash);
+	} else if (home != NULL) {
+		n = snprintf(path, size, "%s/.cache/flui/keymap-%016" PRIx64 ".xkb", home, key_hash);
+	} else {
+		return false;
+	}
+	return n > 0 && (size_t)n < size;
+}
+
+/* Cache files contain the key, a NUL byte, then the serialized keymap */
+static struct xkb_keymap *read_cached_keymap(struct xkb_context *context, const char *path, const char *key) {
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct xkb_keymap *keymap = NULL;
+	struct stat st;
+	size_t key_len = strlen(key) + 1;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size <= key_len) {
+		close(fd);
+		return NULL;
+	}
+
+	size_t size = st.st_size;
+	char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+
+	if (memcmp(data, key, key_len) == 0) {
+		keymap = xkb_keymap_new_from_buffer(context, data + key_len, size - key_len,
+			XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	}
+	munmap(data, size);
+	return keymap;
+}
+
+static void write_cached_keymap(struct xkb_keymap *keymap, const char *path, const char *key) {
+	char *str = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
+	if (str == NULL) {
+		wlr_log(WLR_ERROR, "Failed to serialize keymap for the cache");
+		return;
+	}
+
+	struct iovec iov[] = {
+		{ .iov_base = (void *)key, .iov_len = strlen(key) + 1 },
+		{ .iov_base = str, .iov_len = strlen(str) },
+	};
+	if (!write_file_atomic(path, iov, sizeof(iov) / sizeof(iov[0]))) {
+		wlr_log_errno(WLR_ERROR, "Failed to write keymap cache file %s", path);
+	}
+	free(str);
+}
+
+/* Load keymap from cache, compile and cache it on a miss */
+struct xkb_keymap *load_keymap(struct xkb_context *context) {
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	/* Anything which doesn't fit the buffers falls back to a full compile */
+	char key[1024];
+	char path[PATH_MAX];
+	bool have_cache = get_cache_key(key, sizeof(key)) && get_cache_path(path, sizeof(path), key);
+	if (have_cache) {
+		struct xkb_keymap *keymap = read_cached_keymap(context, path, key);
+		if (keymap != NULL) {
+			wlr_log(WLR_DEBUG, "Loaded cached keymap in %.2f ms", elapsed_ms(&start));
+			return keymap;
+		}
+	}
+
+	struct xkb_keymap *keymap = xkb_keymap_new_from_names(context, NULL, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	if (keymap == NULL) {
+		return NULL;
+	}
+	wlr_log(WLR_DEBUG, "Compiled keymap in %.2f ms", elapsed_ms(&start));
+
+	if (have_cache) {
+		write_cached_keymap(keymap, path, key);
+	}
+	return keymap;
+}
@@ -0,0 +1,8 @@
+#include <xkbcommon/xkbcommon.h>
+
+#ifndef __flui_keymap_h
+#define __flui_keymap_h
+
+struct xkb_keymap *load_keymap(struct xkb_context *context);
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 
 #include "layout.h"
+#include "output.h"
 #include "server.h"
 
 /* Focus toplevel window (keyboard focus only) */
@@ -36,6 +37,85 @@ void focus_toplevel(struct flui_toplevel *toplevel) {
 	}
 }
 
+/* Hide the fullscreen layer of an output */
+static void clear_fullscreen_output(struct flui_output *output) {
+	output->fullscreen->fullscreen_output = NULL;
+	output->fullscreen = NULL;
+	wlr_scene_node_set_enabled(&output->fullscreen_tree->node, false);
+}
+
+/* Fit the fullscreen layer and its toplevel to the output's place in the layout */
+void update_fullscreen_geometry(struct flui_output *output) {
+	struct wlr_box box;
+	wlr_output_layout_get_box(output->server->output_layout, output->wlr_output, &box);
+	wlr_scene_node_set_position(&output->fullscreen_tree->node, box.x, box.y);
+	wlr_scene_rect_set_size(output->fullscreen_bg, box.width, box.height);
+
+	struct flui_toplevel *toplevel = output->fullscreen;
+	if (toplevel != NULL && !wlr_box_empty(&box) &&
+			(toplevel->xdg_toplevel->pending.width != box.width ||
+			toplevel->xdg_toplevel->pending.height != box.height)) {
+		wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, box.width, box.height);
+	}
+}
+
+/* Move toplevel into the fullscreen layer of output, or back to the other toplevels if output is NULL */
+void set_toplevel_fullscreen(struct flui_toplevel *toplevel, struct flui_output *output) {
+	struct flui_server *server = toplevel->server;
+	if (toplevel->fullscreen_output == output) {
+		return;
+	}
+
+	if (toplevel->fullscreen_output != NULL) {
+		clear_fullscreen_output(toplevel->fullscreen_output);
+		wlr_scene_node_reparent(&toplevel->scene_tree->node, server->toplevel_layer);
+	}
+	if (output == NULL) {
+		return;
+	}
+
+	/* Only one fullscreen toplevel per output */
+	if (output->fullscreen != NULL) {
+		struct flui_toplevel *prev = output->fullscreen;
+		wlr_xdg_toplevel_set_fullscreen(prev->xdg_toplevel, false);
+		set_toplevel_fullscreen(prev, NULL);
+	}
+
+	update_fullscreen_geometry(output);
+
+	wlr_scene_node_reparent(&toplevel->scene_tree->node, output->fullscreen_tree);
+	wlr_scene_node_set_position(&toplevel->scene_tree->node, 0, 0);
+	wlr_scene_node_set_enabled(&output->fullscreen_tree->node, true);
+
+	output->fullscreen = toplevel;
+	toplevel->fullscreen_output = output;
+}
+
+/* Send the queued size, unless the client hasn't caught up with the previous one yet */
+static void flush_toplevel_size(struct flui_toplevel *toplevel) {
+	if (!toplevel->resize_queued || toplevel->resize_serial != 0) {
+		return;
+	}
+	toplevel->resize_serial = wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel,
+		toplevel->resize_width, toplevel->resize_height);
+	toplevel->resize_sent_x = toplevel->resize_x;
+	toplevel->resize_sent_y = toplevel->resize_y;
+	toplevel->resize_queued = false;
+}
+
+/*
+ * Request a new geometry during interactive resize, coalescing sizes while a configure is in flight.
+ * The window only moves once the client commits the matching size, so the anchored edges stay put.
+ */
+void request_toplevel_size(struct flui_toplevel *toplevel, int x, int y, int width, int height) {
+	toplevel->resize_x = x;
+	toplevel->resize_y = y;
+	toplevel->resize_width = width;
+	toplevel->resize_height = height;
+	toplevel->resize_queued = true;
+	flush_toplevel_size(toplevel);
+}
+
 /* Handle surfaces ready to display */
 static void xdg_toplevel_map(struct wl_listener *listener, void *data) {
 	struct flui_toplevel *toplevel = wl_container_of(listener, toplevel, map);
@@ -55,6 +135,8 @@ static void xdg_toplevel_unmap(struct wl_listener *listener, void *data) {
 		reset_cursor_mode(toplevel->server);
 	}
 
+	set_toplevel_fullscreen(toplevel, NULL);
+
 	pointer_list_remove(toplevel->server->sw_toplevels, toplevel);
 	wl_list_remove(&toplevel->link);
 }
@@ -67,12 +149,26 @@ static void xdg_toplevel_commit(struct wl_listener *listener, void *data) {
 		/* Return config, allow the surface to decide own size */
 		wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, 0, 0);
 	}
+
+	/* The client has committed a state acking our resize (or anything later) */
+	uint32_t acked = toplevel->xdg_toplevel->base->current.configure_serial;
+	if (toplevel->resize_serial != 0 && (int32_t)(acked - toplevel->resize_serial) >= 0) {
+		struct wlr_box *geo_box = &toplevel->xdg_toplevel->base->geometry;
+		wlr_scene_node_set_position(&toplevel->scene_tree->node,
+			toplevel->resize_sent_x - geo_box->x, toplevel->resize_sent_y - geo_box->y);
+		toplevel->resize_serial = 0;
+		flush_toplevel_size(toplevel);
+	}
 }
 
 /* Handle toplevel destruction */
 static void xdg_toplevel_destroy(struct wl_listener *listener, void *data) {
 	struct flui_toplevel *toplevel = wl_container_of(listener, toplevel, destroy);
 
+	if (toplevel->fullscreen_output != NULL) {
+		clear_fullscreen_output(toplevel->fullscreen_output);
+	}
+
 	wl_list_remove(&toplevel->map.link);
 	wl_list_remove(&toplevel->unmap.link);
 	wl_list_remove(&toplevel->commit.link);
@@ -89,6 +185,7 @@ static void xdg_toplevel_destroy(struct wl_listener *listener, void *data) {
 static void begin_interactive(struct flui_toplevel *toplevel, enum flui_cursor_mode mode, uint32_t edges) {
 	struct flui_server *server = toplevel->server;
 
+	apply_pending_move(server);
 	server->grabbed_toplevel = toplevel;
 	server->cursor_mode = mode;
 
@@ -114,7 +211,7 @@ static void begin_interactive(struct flui_toplevel *toplevel, enum flui_cursor_m
 /* Handle client requests for interactive movements */
 static void xdg_toplevel_request_move(struct wl_listener *listener, void *data) {
 	struct flui_toplevel *toplevel = wl_container_of(listener, toplevel, request_move);
-	if (toplevel->xdg_toplevel->pending.maximized) { return; }
+	if (toplevel->xdg_toplevel->pending.maximized || toplevel->fullscreen_output != NULL) { return; }
 	begin_interactive(toplevel, FLUI_CURSOR_MOVE, 0);
 }
 
@@ -122,7 +219,7 @@ static void xdg_toplevel_request_move(struct wl_listener *listener, void *data)
 static void xdg_toplevel_request_resize(struct wl_listener *listener, void *data) {
 	struct wlr_xdg_toplevel_resize_event *event = data;
 	struct flui_toplevel *toplevel = wl_container_of(listener, toplevel, request_resize);
-	if (toplevel->xdg_toplevel->pending.maximized) { return; }
+	if (toplevel->xdg_toplevel->pending.maximized || toplevel->fullscreen_output != NULL) { return; }
 	begin_interactive(toplevel, FLUI_CURSOR_RESIZE, event->edges);
 }
 
@@ -180,11 +277,12 @@ static void xdg_toplevel_request_fullscreen(struct wl_listener *listener, void *
 	if (toplevel->xdg_toplevel->pending.fullscreen) {
 		wlr_xdg_toplevel_set_fullscreen(toplevel->xdg_toplevel, false);
 		wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, width / 2, height / 2);
+		set_toplevel_fullscreen(toplevel, NULL);
 		wlr_scene_node_set_position(&toplevel->scene_tree->node, width / 4, height / 4);
 	} else {
 		wlr_xdg_toplevel_set_fullscreen(toplevel->xdg_toplevel, true);
 		wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, width, height);
-		wlr_scene_node_set_position(&toplevel->scene_tree->node, 0, 0);
+		set_toplevel_fullscreen(toplevel, output->data);
 	}
 
 	wlr_xdg_surface_schedule_configure(toplevel->xdg_toplevel->base);
@@ -199,7 +297,7 @@ void server_new_xdg_toplevel(struct wl_listener *listener, void *data) {
 	struct flui_toplevel *toplevel = calloc(1, sizeof(*toplevel));
 	toplevel->server = server;
 	toplevel->xdg_toplevel = xdg_toplevel;
-	toplevel->scene_tree = wlr_scene_xdg_surface_create(&toplevel->server->scene->tree, xdg_toplevel->base);
+	toplevel->scene_tree = wlr_scene_xdg_surface_create(server->toplevel_layer, xdg_toplevel->base);
 	toplevel->scene_tree->node.data = toplevel;
 	xdg_toplevel->base->data = toplevel->scene_tree;
 
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <wayland-server-core.h>
@@ -24,11 +25,21 @@
 #ifndef __flui_layout_h
 #define __flui_layout_h
 
+struct flui_output;
+
 struct flui_toplevel {
 	struct wl_list link;
 	struct flui_server *server;
 	struct wlr_xdg_toplevel *xdg_toplevel;
 	struct wlr_scene_tree *scene_tree;
+	struct flui_output *fullscreen_output;
+	/* Interactive resize: serial of the unanswered configure and the latest size not sent yet */
+	uint32_t resize_serial;
+	bool resize_queued;
+	int resize_width, resize_height;
+	/* Layout position of the window geometry, queued and for the configure in flight */
+	int resize_x, resize_y;
+	int resize_sent_x, resize_sent_y;
 	struct wl_listener map;
 	struct wl_listener unmap;
 	struct wl_listener commit;
@@ -46,6 +57,9 @@ struct flui_popup {
 };
 
 void focus_toplevel(struct flui_toplevel *toplevel);
+void update_fullscreen_geometry(struct flui_output *output);
+void set_toplevel_fullscreen(struct flui_toplevel *toplevel, struct flui_output *output);
+void request_toplevel_size(struct flui_toplevel *toplevel, int x, int y, int width, int height);
 void server_new_xdg_toplevel(struct wl_listener *listener, void *data);
 void server_new_xdg_popup(struct wl_listener *listener, void *data);
 
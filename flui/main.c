@@ -32,7 +32,7 @@
 #include "server.h"
 
 int main(int argc, char *argv[]) {
-	wlr_log_init(WLR_DEBUG, NULL);
+	wlr_log_init_async(WLR_DEBUG);
 	char *startup_cmd = NULL;
 
 	int c;
@@ -59,10 +59,20 @@ int main(int argc, char *argv[]) {
 	wl_list_init(&server.outputs);
 	server.new_output.notify = server_new_output;
 	wl_signal_add(&server.backend->events.new_output, &server.new_output);
+	server.layout_change.notify = server_layout_change;
+	wl_signal_add(&server.output_layout->events.change, &server.layout_change);
 
 	/* Create a scene graph */
 	server.scene = wlr_scene_create();
+	/* Let occluded and off-screen windows render at 1 Hz */
+	wlr_scene_set_hidden_frame_interval(server.scene, 1000);
 	server.scene_layout = wlr_scene_attach_output_layout(server.scene, server.output_layout);
+	if (server.linux_dmabuf != NULL) {
+		wlr_scene_set_linux_dmabuf_v1(server.scene, server.linux_dmabuf);
+	}
+	/* Fullscreen windows are kept above all others so they can be scanned out */
+	server.toplevel_layer = wlr_scene_tree_create(&server.scene->tree);
+	server.fullscreen_layer = wlr_scene_tree_create(&server.scene->tree);
 
 	/* Set up xdg-shell version 3 */
 	wl_list_init(&server.toplevels);
@@ -92,6 +102,8 @@ int main(int argc, char *argv[]) {
 	wl_signal_add(&server.cursor->events.axis, &server.cursor_axis);
 	server.cursor_frame.notify = server_cursor_frame;
 	wl_signal_add(&server.cursor->events.frame, &server.cursor_frame);
+	server.motion_timer = wl_event_loop_add_timer(wl_display_get_event_loop(server.wl_display),
+			server_motion_timer, &server);
 
 	/* Configure seat for user */
 	wl_list_init(&server.keyboards);
@@ -105,6 +117,11 @@ int main(int argc, char *argv[]) {
 	wl_signal_add(&server.seat->events.request_set_selection,
 			&server.request_set_selection);
 
+	/* Compile the keymap shared by all keyboards */
+	if (!server_setup_keyboards(&server)) {
+		wlr_log(WLR_ERROR, "Failed to set up keyboards");
+	}
+
 	/* Add a Unix socket to the Wayland display */
 	const char *socket = wl_display_add_socket_auto(server.wl_display);
 	if (!socket) {
@@ -1,8 +1,114 @@
 #include <stdlib.h>
+#include <time.h>
 
+#include "config.h"
+#include "layout.h"
 #include "output.h"
 #include "server.h"
 
+static const char *present_policy_name(enum flui_present_policy policy) {
+	switch (policy) {
+	case FLUI_PRESENT_DEFAULT:
+		return "default";
+	case FLUI_PRESENT_LATENCY:
+		return "latency";
+	case FLUI_PRESENT_SMOOTH:
+		return "smooth";
+	}
+	return "unknown";
+}
+
+/* Only the fullscreen window gets a say in how the output presents */
+static enum flui_present_policy get_present_policy(struct flui_output *output, bool *tearing) {
+	struct flui_server *server = output->server;
+	*tearing = false;
+	if (output->fullscreen == NULL) {
+		return FLUI_PRESENT_DEFAULT;
+	}
+
+	struct wlr_surface *surface = output->fullscreen->xdg_toplevel->base->surface;
+	enum wp_content_type_v1_type content_type = wlr_surface_get_content_type_v1(server->content_type, surface);
+	if (content_type == WP_CONTENT_TYPE_V1_TYPE_VIDEO) {
+		return FLUI_PRESENT_SMOOTH;
+	}
+
+	*tearing = wlr_tearing_control_manager_v1_surface_hint_from_surface(server->tearing_control, surface) ==
+		WP_TEARING_CONTROL_V1_PRESENTATION_HINT_ASYNC;
+	if (*tearing || content_type == WP_CONTENT_TYPE_V1_TYPE_GAME) {
+		return FLUI_PRESENT_LATENCY;
+	}
+	return FLUI_PRESENT_DEFAULT;
+}
+
+static double elapsed_ms(const struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/*
+ * Outputs are rendered one after the other on the main loop, the scene graph and the renderer
+ * aren't thread-safe. A slow output delays the frame events of all the others, so keep track
+ * of frames which don't fit in the refresh period.
+ */
+static void output_check_frame_budget(struct flui_output *output, const struct timespec *start, bool tearing) {
+	int refresh_mhz = output->wlr_output->refresh > 0 ? output->wlr_output->refresh : 60000;
+	double budget_ms = 1000000.0 / refresh_mhz;
+	double ms = elapsed_ms(start);
+	if (ms > budget_ms) {
+		output->late_frames++;
+		wlr_log(WLR_DEBUG, "Output %s took %.2f ms to render, over its %.2f ms budget "
+			"(%s policy, %s commit, %u late frames)", output->wlr_output->name, ms, budget_ms,
+			present_policy_name(output->present_policy), tearing ? "tearing" : "vsync",
+			output->late_frames);
+	}
+}
+
+/* Render the scene and commit it according to the presentation policy */
+static void output_commit_scene(struct flui_output *output, struct wlr_scene_output *scene_output) {
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	bool tearing;
+	enum flui_present_policy policy = get_present_policy(output, &tearing);
+	if (policy != output->present_policy) {
+		wlr_log(WLR_DEBUG, "Output %s presentation policy: %s -> %s", wlr_output->name,
+			present_policy_name(output->present_policy), present_policy_name(policy));
+		output->present_policy = policy;
+	}
+
+	if (!wlr_scene_output_needs_frame(scene_output)) {
+		return;
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	if (!wlr_scene_output_build_state(scene_output, &state, NULL)) {
+		wlr_output_state_finish(&state);
+		return;
+	}
+
+	/* Variable refresh lets games present early and videos keep their own frame rate */
+	bool adaptive_sync = policy != FLUI_PRESENT_DEFAULT && wlr_output->adaptive_sync_supported;
+	if (adaptive_sync != (wlr_output->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED)) {
+		wlr_output_state_set_adaptive_sync_enabled(&state, adaptive_sync);
+	}
+	wlr_output_state_set_tearing_page_flip(&state, tearing);
+
+	if (!wlr_output_commit_state(wlr_output, &state) && (tearing || adaptive_sync)) {
+		/* The backend may refuse either, fall back to a plain vsynced frame */
+		wlr_output_state_set_tearing_page_flip(&state, false);
+		tearing = false;
+		state.committed &= ~WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED;
+		wlr_output_commit_state(wlr_output, &state);
+	}
+	wlr_output_state_finish(&state);
+
+	output_check_frame_budget(output, &start, tearing);
+}
+
 /* Handle rendering each frame */
 static void output_frame(struct wl_listener *listener, void *data) {
 	struct flui_output *output = wl_container_of(listener, output, frame);
@@ -10,8 +116,13 @@ static void output_frame(struct wl_listener *listener, void *data) {
 
 	struct wlr_scene_output *scene_output = wlr_scene_get_scene_output(scene, output->wlr_output);
 
+	/* Catch up with an interactive move before rendering */
+	apply_pending_move(output->server);
+	/* Coalesced pointer motion is delivered at most once per frame */
+	flush_pointer_motion(output->server);
+
 	/* Render scene */
-	wlr_scene_output_commit(scene_output, NULL);
+	output_commit_scene(output, scene_output);
 
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
@@ -29,6 +140,15 @@ static void output_request_state(struct wl_listener *listener, void *data) {
 static void output_destroy(struct wl_listener *listener, void *data) {
 	struct flui_output *output = wl_container_of(listener, output, destroy);
 
+	if (output->fullscreen != NULL) {
+		/* Let the client know it lost its output */
+		wlr_xdg_toplevel_set_fullscreen(output->fullscreen->xdg_toplevel, false);
+		set_toplevel_fullscreen(output->fullscreen, NULL);
+	}
+	if (output->fullscreen_tree != NULL) {
+		wlr_scene_node_destroy(&output->fullscreen_tree->node);
+	}
+
 	wl_list_remove(&output->frame.link);
 	wl_list_remove(&output->request_state.link);
 	wl_list_remove(&output->destroy.link);
@@ -37,6 +157,17 @@ static void output_destroy(struct wl_listener *listener, void *data) {
 }
 
 
+/* Handle layout changes, including outputs changing mode, scale or transform */
+void server_layout_change(struct wl_listener *listener, void *data) {
+	struct flui_server *server = wl_container_of(listener, server, layout_change);
+	struct flui_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output->fullscreen_tree != NULL) {
+			update_fullscreen_geometry(output);
+		}
+	}
+}
+
 /* Handle new outputs (i.e. displays) */
 void server_new_output(struct wl_listener *listener, void *data) {
 	struct flui_server *server = wl_container_of(listener, server, new_output);
@@ -56,6 +187,9 @@ void server_new_output(struct wl_listener *listener, void *data) {
 		wlr_output_state_set_mode(&state, mode);
 	}
 
+	/* The scene passes the scale on to surfaces as their preferred (fractional) scale */
+	wlr_output_state_set_scale(&state, config.output_scale);
+
 	/* Apply new output state */
 	wlr_output_commit_state(wlr_output, &state);
 	wlr_output_state_finish(&state);
@@ -64,6 +198,11 @@ void server_new_output(struct wl_listener *listener, void *data) {
 	struct flui_output *output = calloc(1, sizeof(*output));
 	output->wlr_output = wlr_output;
 	output->server = server;
+	wlr_output->data = output;
+
+	output->fullscreen_tree = wlr_scene_tree_create(server->fullscreen_layer);
+	output->fullscreen_bg = wlr_scene_rect_create(output->fullscreen_tree, 0, 0, (float[4]){ 0.f, 0.f, 0.f, 1.f });
+	wlr_scene_node_set_enabled(&output->fullscreen_tree->node, false);
 
 	/* Set up event handlers */
 	output->frame.notify = output_frame;
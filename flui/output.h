@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/backend.h>
@@ -25,15 +26,30 @@
 #ifndef __flui_output_h
 #define __flui_output_h
 
+/* How frames are presented, picked from the fullscreen window's hints */
+enum flui_present_policy {
+	FLUI_PRESENT_DEFAULT,
+	FLUI_PRESENT_LATENCY, /* Tearing page-flips if requested, adaptive sync */
+	FLUI_PRESENT_SMOOTH, /* Never tearing, adaptive sync to follow the content's frame rate */
+};
+
 struct flui_output {
 	struct wl_list link;
 	struct flui_server *server;
 	struct wlr_output *wlr_output;
+	/* Black backdrop and the fullscreen toplevel, hides everything below */
+	struct wlr_scene_tree *fullscreen_tree;
+	struct wlr_scene_rect *fullscreen_bg;
+	struct flui_toplevel *fullscreen;
+	enum flui_present_policy present_policy;
+	/* Frames whose rendering overran the refresh period, see output_commit_scene */
+	uint32_t late_frames;
 	struct wl_listener frame;
 	struct wl_listener request_state;
 	struct wl_listener destroy;
 };
 
+void server_layout_change(struct wl_listener *listener, void *data);
 void server_new_output(struct wl_listener *listener, void *data);
 
 #endif
@@ -1,3 +1,4 @@
+#include "output.h"
 #include "server.h"
 
 struct flui_server server_setup(void) {
@@ -13,7 +14,19 @@ struct flui_server server_setup(void) {
 	server.renderer = wlr_renderer_autocreate(server.backend);
 	assert(server.renderer != NULL);
 
-	wlr_renderer_init_wl_display(server.renderer, server.wl_display);
+	wlr_renderer_init_wl_shm(server.renderer, server.wl_display);
+
+	/* Keep linux-dmabuf around so the scene can send scanout feedback */
+	if (wlr_renderer_get_texture_formats(server.renderer, WLR_BUFFER_CAP_DMABUF) != NULL &&
+			wlr_renderer_get_drm_fd(server.renderer) >= 0) {
+		server.linux_dmabuf = wlr_linux_dmabuf_v1_create_with_renderer(server.wl_display, 4, server.renderer);
+	}
+
+	/* Explicit sync needs timelines on both ends: the renderer waits on acquire points, outputs on scanout */
+	int drm_fd = wlr_renderer_get_drm_fd(server.renderer);
+	if (server.renderer->features.timeline && server.backend->features.timeline && drm_fd >= 0) {
+		server.syncobj_manager = wlr_linux_drm_syncobj_manager_v1_create(server.wl_display, 1, drm_fd);
+	}
 
 	/* Create memory allocator */
 	server.allocator = wlr_allocator_autocreate(server.backend, server.renderer);
@@ -23,6 +36,16 @@ struct flui_server server_setup(void) {
 	wlr_compositor_create(server.wl_display, 5, server.renderer);
 	wlr_subcompositor_create(server.wl_display);
 	wlr_data_device_manager_create(server.wl_display);
+	server.relative_pointer = wlr_relative_pointer_manager_v1_create(server.wl_display);
+
+	/* Let clients pace themselves and submit buffers at the output scale */
+	wlr_presentation_create(server.wl_display, server.backend, 2);
+	wlr_viewporter_create(server.wl_display);
+	wlr_fractional_scale_manager_v1_create(server.wl_display, 1);
+
+	/* Hints used to pick how fullscreen windows are presented */
+	server.tearing_control = wlr_tearing_control_manager_v1_create(server.wl_display, 1);
+	server.content_type = wlr_content_type_manager_v1_create(server.wl_display, 1);
 
 	/* Create an output layout */
 	server.output_layout = wlr_output_layout_create(server.wl_display);
@@ -45,19 +68,27 @@ void cleanup_server(struct flui_server *server) {
 	wl_list_remove(&server->cursor_button.link);
 	wl_list_remove(&server->cursor_axis.link);
 	wl_list_remove(&server->cursor_frame.link);
+	wl_event_source_remove(server->motion_timer);
 
 	wl_list_remove(&server->new_input.link);
 	wl_list_remove(&server->request_cursor.link);
 	wl_list_remove(&server->request_set_selection.link);
 
 	wl_list_remove(&server->new_output.link);
+	wl_list_remove(&server->layout_change.link);
 
+	/* Fullscreen trees go away with the scene, before the outputs */
+	struct flui_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		output->fullscreen_tree = NULL;
+	}
 	wlr_scene_node_destroy(&server->scene->tree.node);
 	wlr_xcursor_manager_destroy(server->cursor_mgr);
 	wlr_cursor_destroy(server->cursor);
 	wlr_allocator_destroy(server->allocator);
 	wlr_renderer_destroy(server->renderer);
 	wlr_backend_destroy(server->backend);
+	server_cleanup_keyboards(server);
 	wl_display_destroy(server->wl_display);
 
 	destroy_pointer_list(server->sw_toplevels);
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <wayland-server-core.h>
@@ -7,15 +8,24 @@
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_content_type_v1.h>
 #include <wlr/types/wlr_data_device.h>
+#include <wlr/types/wlr_fractional_scale_v1.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_keyboard_group.h>
+#include <wlr/types/wlr_linux_dmabuf_v1.h>
+#include <wlr/types/wlr_linux_drm_syncobj_v1.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_presentation_time.h>
+#include <wlr/types/wlr_relative_pointer_v1.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_subcompositor.h>
+#include <wlr/types/wlr_tearing_control_v1.h>
+#include <wlr/types/wlr_viewporter.h>
 #include <wlr/types/wlr_xcursor_manager.h>
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/util/log.h>
@@ -34,6 +44,12 @@ struct flui_server {
 	struct wlr_allocator *allocator;
 	struct wlr_scene *scene;
 	struct wlr_scene_output_layout *scene_layout;
+	struct wlr_scene_tree *toplevel_layer;
+	struct wlr_scene_tree *fullscreen_layer;
+	struct wlr_linux_dmabuf_v1 *linux_dmabuf;
+	struct wlr_linux_drm_syncobj_manager_v1 *syncobj_manager;
+	struct wlr_tearing_control_manager_v1 *tearing_control;
+	struct wlr_content_type_manager_v1 *content_type;
 
 	struct wlr_xdg_shell *xdg_shell;
 	struct wl_listener new_xdg_toplevel;
@@ -49,19 +65,31 @@ struct flui_server {
 	struct wl_listener cursor_button;
 	struct wl_listener cursor_axis;
 	struct wl_listener cursor_frame;
+	struct wlr_relative_pointer_manager_v1 *relative_pointer;
+	struct wl_event_source *motion_timer;
+	bool motion_pending;
+	uint32_t motion_time;
+	double motion_dx, motion_dy;
+	double motion_unaccel_dx, motion_unaccel_dy;
 
 	struct wlr_seat *seat;
 	struct wl_listener new_input;
 	struct wl_listener request_cursor;
 	struct wl_listener request_set_selection;
 	struct wl_list keyboards;
+	struct xkb_keymap *keymap;
+	struct wlr_keyboard_group *keyboard_group;
+	struct flui_keyboard *group_keyboard;
 	enum flui_cursor_mode cursor_mode;
 	struct flui_toplevel *grabbed_toplevel;
 	double grab_x, grab_y;
+	bool move_pending;
+	double move_x, move_y;
 	struct wlr_box grab_geobox;
 	uint32_t resize_edges;
 
 	struct wlr_output_layout *output_layout;
+	struct wl_listener layout_change;
 	struct wl_list outputs;
 	struct wl_listener new_output;
 };
@@ -12,6 +12,7 @@ struct wlr_headless_backend {
 	struct wl_list outputs;
 	struct wl_listener event_loop_destroy;
 	bool started;
+	bool virtual_clock;
 };
 
 struct wlr_headless_output {
@@ -20,8 +21,19 @@ struct wlr_headless_output {
 	struct wlr_headless_backend *backend;
 	struct wl_list link;
 
-	struct wl_event_source *frame_timer;
-	int frame_delay; // ms
+	int vblank_fd; // CLOCK_MONOTONIC timerfd
+	struct wl_event_source *vblank_source;
+	struct wl_event_source *virtual_vblank_idle;
+	bool vblank_armed;
+
+	int64_t refresh_nsec;
+	int64_t last_vblank_nsec; // all vblanks are phase-locked to this one
+	int64_t next_vblank_nsec;
+	unsigned vblank_seq;
+
+	// Commits waiting for the next vblank to be presented
+	bool present_pending;
+	uint32_t present_seq_first, present_seq_last;
 };
 
 struct wlr_headless_backend *headless_backend_from_backend(
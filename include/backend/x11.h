@@ -48,6 +48,13 @@ struct wlr_x11_output {
 
 	uint64_t last_msc;
 
+	// Statistics for the last presented buffer, logged on completion
+	struct {
+		uint32_t serial;
+		int64_t commit_nsec;
+		uint64_t bytes; // size of the update region
+	} frame_stats;
+
 	struct {
 		struct wlr_swapchain *swapchain;
 		xcb_render_picture_t pic;
@@ -5,7 +5,9 @@
 #include <wlr/render/interface.h>
 #include <wlr/render/pixman.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/util/addon.h>
 #include "render/pixel_format.h"
+#include "util/rect_union.h"
 
 struct wlr_pixman_pixel_format {
 	uint32_t drm_format;
@@ -13,12 +15,17 @@ struct wlr_pixman_pixel_format {
 };
 
 struct wlr_pixman_buffer;
+struct wlr_pixman_workers;
 
 struct wlr_pixman_renderer {
 	struct wlr_renderer wlr_renderer;
 
 	struct wl_list buffers; // wlr_pixman_buffer.link
 	struct wl_list textures; // wlr_pixman_texture.link
+	struct wl_list color_transforms; // wlr_pixman_color_transform.link
+	// Threads applying color transforms, started on first large transform
+	struct wlr_pixman_workers *workers;
+	bool workers_started;
 
 	struct wlr_drm_format_set drm_formats;
 };
@@ -46,9 +53,29 @@ struct wlr_pixman_texture {
 	struct wlr_buffer *buffer; // if created via texture_from_buffer
 };
 
+#define PIXMAN_LUT_MAX_CHANNEL_BITS 10
+
+// Per-renderer state for a 3D LUT color transform
+struct wlr_pixman_color_transform {
+	struct wlr_addon addon; // owned by: wlr_pixman_renderer
+	struct wl_list link; // wlr_pixman_renderer.color_transforms
+
+	// Lattice position of each sRGB-encoded channel value once decoded to
+	// linear: the lower LUT index and the weight of the upper neighbour.
+	// Indexed by channel bit depth, built on demand.
+	struct wlr_pixman_lut_decode {
+		uint16_t index;
+		float weight;
+	} *decode[PIXMAN_LUT_MAX_CHANNEL_BITS + 1];
+};
+
 struct wlr_pixman_render_pass {
 	struct wlr_render_pass base;
 	struct wlr_pixman_buffer *buffer;
+
+	struct wlr_color_transform *color_transform;
+	// Region written to during the pass, only tracked with a color transform
+	struct rect_union updated_region;
 };
 
 pixman_format_code_t get_pixman_format_from_drm(uint32_t fmt);
@@ -59,6 +86,23 @@ bool begin_pixman_data_ptr_access(struct wlr_buffer *buffer, pixman_image_t **im
 	uint32_t flags);
 
 struct wlr_pixman_render_pass *begin_pixman_render_pass(
-	struct wlr_pixman_buffer *buffer);
+	struct wlr_pixman_buffer *buffer, const struct wlr_buffer_pass_options *options);
+void pixman_color_transform_destroy(struct wlr_addon *addon);
+
+typedef void (*pixman_workers_func_t)(void *data, size_t task);
+
+/**
+ * Start a pool of worker threads, returns NULL if the machine has a single
+ * CPU or the threads can't be started.
+ */
+struct wlr_pixman_workers *pixman_workers_create(void);
+void pixman_workers_destroy(struct wlr_pixman_workers *workers);
+/**
+ * Call func for each task index in [0, tasks_len), spread over the workers
+ * and the calling thread. Returns once all tasks have run. Runs everything on
+ * the calling thread if workers is NULL.
+ */
+void pixman_workers_run(struct wlr_pixman_workers *workers,
+	pixman_workers_func_t func, void *data, size_t tasks_len);
 
 #endif
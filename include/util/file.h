@@ -0,0 +1,18 @@
+#ifndef UTIL_FILE_H
+#define UTIL_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+/**
+ * Replace the file at path with the concatenation of the iovecs, creating
+ * missing parent directories with mode 0700.
+ *
+ * The data is written to a temporary file which is then renamed over path,
+ * so readers never see a partially written file. On error, false is returned
+ * and errno is set.
+ */
+bool write_file_atomic(const char *path, const struct iovec *iov, size_t iov_len);
+
+#endif
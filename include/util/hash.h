@@ -0,0 +1,17 @@
+#ifndef UTIL_HASH_H
+#define UTIL_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_FNV1A_INIT UINT64_C(0xcbf29ce484222325)
+
+/**
+ * Mix data into a 64-bit FNV-1a hash, starting from HASH_FNV1A_INIT.
+ *
+ * Collisions are easy to produce: callers must compare the hashed data when
+ * a collision matters.
+ */
+uint64_t hash_fnv1a(uint64_t hash, const void *data, size_t size);
+
+#endif
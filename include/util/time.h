@@ -11,6 +11,11 @@ static const long NSEC_PER_SEC = 1000000000;
  */
 int64_t get_current_time_msec(void);
 
+/**
+ * Get the current time, in nanoseconds.
+ */
+int64_t get_current_time_nsec(void);
+
 /**
  * Convert a timespec to milliseconds.
  */
@@ -17,6 +17,17 @@
  * default.
  */
 struct wlr_backend *wlr_headless_backend_create(struct wl_event_loop *loop);
+/**
+ * Enable or disable the virtual clock.
+ *
+ * By default, headless outputs refresh in real time, following an absolute
+ * vblank schedule based on CLOCK_MONOTONIC. With the virtual clock enabled,
+ * the vblank following a commit happens as soon as the event loop is idle and
+ * each output's clock advances by exactly one refresh period per frame. This
+ * makes frame pacing and presentation timestamps deterministic.
+ */
+void wlr_headless_backend_set_virtual_clock(struct wlr_backend *backend,
+	bool enabled);
 /**
  * Create a new headless output.
  *
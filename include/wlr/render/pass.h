@@ -31,7 +31,12 @@ struct wlr_buffer_pass_options {
 	/* Timer to measure the duration of the render pass */
 	struct wlr_render_timer *timer;
 	/* Color transform to apply to the output of the render pass,
-	 * leave NULL to indicate sRGB/no custom transform */
+	 * leave NULL to indicate sRGB/no custom transform.
+	 *
+	 * The pixman renderer applies the transform in place to the areas drawn
+	 * during the pass. Every drawn area must be fully repainted by the pass:
+	 * blending over contents left by a previous pass would apply the
+	 * transform to them twice. */
 	struct wlr_color_transform *color_transform;
 
 	/* Signal a timeline synchronization point when the render pass completes.
@@ -23,6 +23,10 @@ struct wlr_idle_notifier_v1 {
 		bool inhibited;
 		struct wl_list notifications; // wlr_idle_notification_v1.link
 
+		// Fires at the earliest deadline of all notifications
+		struct wl_event_source *timer;
+		bool timer_armed;
+
 		struct wl_listener display_destroy;
 	} WLR_PRIVATE;
 };
@@ -40,6 +40,7 @@ enum wlr_keyboard_modifier {
 #define WLR_KEYBOARD_KEYS_CAP 32
 
 struct wlr_keyboard_impl;
+struct wlr_keyboard_keymap_file;
 
 struct wlr_keyboard_modifiers {
 	xkb_mod_mask_t depressed;
@@ -93,6 +94,10 @@ struct wlr_keyboard {
 	} events;
 
 	void *data;
+
+	struct {
+		struct wlr_keyboard_keymap_file *keymap_file;
+	} WLR_PRIVATE;
 };
 
 struct wlr_keyboard_key_event {
@@ -110,6 +115,12 @@ struct wlr_keyboard_key_event {
 struct wlr_keyboard *wlr_keyboard_from_input_device(
 	struct wlr_input_device *input_device);
 
+/**
+ * Set the keymap of the keyboard.
+ *
+ * Keyboards using the same struct xkb_keymap share a single serialized copy
+ * of it, including the read-only file descriptor sent to clients.
+ */
 bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb,
 	struct xkb_keymap *keymap);
 
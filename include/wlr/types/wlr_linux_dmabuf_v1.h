@@ -57,6 +57,8 @@ struct wlr_linux_dmabuf_v1 {
 
 	struct {
 		struct wlr_linux_dmabuf_feedback_v1_compiled *default_feedback;
+		// Compiled feedback shared by all surfaces with identical feedback
+		struct wl_list compiled_feedbacks; // wlr_linux_dmabuf_feedback_v1_compiled.link
 		struct wlr_drm_format_set default_formats; // for legacy clients
 		struct wl_list surfaces; // wlr_linux_dmabuf_v1_surface.link
 
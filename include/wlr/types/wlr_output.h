@@ -493,6 +493,12 @@ void wlr_output_state_set_transform(struct wlr_output_state *state,
  */
 void wlr_output_state_set_adaptive_sync_enabled(struct wlr_output_state *state,
 	bool enabled);
+/**
+ * Requests a tearing page-flip for the buffer of this commit, see
+ * `wlr_output_state.tearing_page_flip`.
+ */
+void wlr_output_state_set_tearing_page_flip(struct wlr_output_state *state,
+	bool enabled);
 /**
  * Sets the render format for an output.
  *
@@ -38,6 +38,10 @@ struct wlr_output_layout {
 
 	struct {
 		struct wl_listener display_destroy;
+
+		// Output which contained the last looked up point
+		struct wlr_output_layout_output *last_hit;
+		bool overlapping; // whether any two outputs overlap
 	} WLR_PRIVATE;
 };
 
@@ -59,6 +63,8 @@ struct wlr_output_layout_output {
 		struct wlr_addon addon;
 
 		struct wl_listener commit;
+
+		struct wlr_box box; // updated on layout changes
 	} WLR_PRIVATE;
 };
 
@@ -17,6 +17,12 @@
  * The scene-graph API only supports basic 2D composition operations (like the
  * KMS API or the Wayland protocol does). For anything more complicated,
  * compositors need to implement custom rendering logic.
+ *
+ * The scene-graph is not thread-safe. All functions, including the ones which
+ * render an output, must be called from the thread running the event loop of
+ * the wl_display the scene's surfaces belong to. Rendering reads the live
+ * scene nodes, buffers and textures, so it can't overlap with changes to the
+ * scene.
  */
 
 #include <pixman.h>
@@ -112,6 +118,8 @@ struct wlr_scene {
 		bool direct_scanout;
 		bool calculate_visibility;
 		bool highlight_transparent_region;
+		int hidden_frame_interval_ms;
+		size_t max_output_layers;
 	} WLR_PRIVATE;
 };
 
@@ -197,6 +205,8 @@ struct wlr_scene_buffer {
 		struct wlr_drm_syncobj_timeline *wait_timeline;
 		uint64_t wait_point;
 
+		int64_t hidden_frame_done_msec;
+
 		struct wl_listener buffer_release;
 		struct wl_listener renderer_destroy;
 	} WLR_PRIVATE;
@@ -234,6 +244,10 @@ struct wlr_scene_output {
 
 		struct wl_array render_list;
 
+		struct wl_array layers; // struct wlr_output_layer *
+		struct wl_array layer_states; // struct wlr_output_layer_state
+		struct wl_array offloaded_nodes; // struct wlr_scene_node *
+
 		struct wlr_drm_syncobj_timeline *in_timeline;
 		uint64_t in_point;
 	} WLR_PRIVATE;
@@ -342,6 +356,31 @@ void wlr_scene_set_linux_dmabuf_v1(struct wlr_scene *scene,
 void wlr_scene_set_gamma_control_manager_v1(struct wlr_scene *scene,
 	struct wlr_gamma_control_manager_v1 *gamma_control);
 
+/**
+ * Sets the interval at which buffers which aren't displayed on any output,
+ * because they are fully occluded or off-screen, receive frame_done events.
+ *
+ * By default such buffers receive no frame_done events at all. With a
+ * positive interval, wlr_scene_output_send_frame_done() sends them one at most
+ * every interval_ms milliseconds, so that their clients keep making progress
+ * at a low rate. A value of 0 restores the default.
+ */
+void wlr_scene_set_hidden_frame_interval(struct wlr_scene *scene,
+	int interval_ms);
+
+/**
+ * Sets the maximum number of output layers used per output to display buffer
+ * nodes without compositing them.
+ *
+ * When set, wlr_scene_output_build_state() proposes the topmost buffer nodes
+ * of an output as output layers and only composites the nodes below the ones
+ * the backend accepts. Like direct scan-out, offloading is disabled while the
+ * output has software cursors or is being captured, since offloaded nodes are
+ * missing from the composited buffer.
+ */
+void wlr_scene_set_max_output_layers(struct wlr_scene *scene,
+	size_t max_layers);
+
 /**
  * Add a node displaying nothing but its children.
  */
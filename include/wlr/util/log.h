@@ -43,6 +43,19 @@ typedef void (*wlr_log_func_t)(enum wlr_log_importance importance,
  */
 void wlr_log_init(enum wlr_log_importance verbosity, wlr_log_func_t callback);
 
+/**
+ * Set the log verbosity and use the default logger in asynchronous mode.
+ *
+ * Messages are formatted into a bounded ring buffer and written to stderr by
+ * a background thread, so that a slow stderr doesn't stall the caller. When
+ * the ring buffer is full, messages are dropped and the number of dropped
+ * messages is reported. Error messages are waited upon until written.
+ *
+ * Pending messages are flushed when the process exits. Falls back to the
+ * synchronous default logger if the background thread can't be started.
+ */
+void wlr_log_init_async(enum wlr_log_importance verbosity);
+
 /**
  * Get the current log verbosity configured by wlr_log_init().
  */
@@ -6,6 +6,8 @@
 #include <wayland-util.h>
 
 #define INCR_CHUNK_SIZE (64 * 1024)
+// Upper bound for INCR chunks, to keep per-transfer memory usage bounded
+#define INCR_MAX_CHUNK_SIZE (4 * 1024 * 1024)
 
 #define XDND_VERSION 5
 
@@ -22,6 +24,7 @@ struct wlr_xwm_selection_transfer {
 	bool incr;
 	bool flush_property_on_delete;
 	bool property_set;
+	size_t chunk_size;
 	struct wl_array source_data;
 	int wl_client_fd;
 	struct wl_event_source *event_source;
@@ -140,6 +140,7 @@ struct wlr_xwm {
 	const xcb_query_extension_reply_t *xfixes;
 	const xcb_query_extension_reply_t *xres;
 	uint32_t xfixes_major_version;
+	size_t max_incr_chunk_size; // bytes
 #if HAVE_XCB_ERRORS
 	xcb_errors_context_t *errors_context;
 #endif
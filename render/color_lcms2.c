@@ -1,8 +1,21 @@
+#include <fcntl.h>
+#include <inttypes.h>
 #include <lcms2.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <wlr/util/log.h>
 #include <wlr/render/color.h>
 #include "render/color.h"
+#include "util/file.h"
+#include "util/hash.h"
+
+// Bump when the LUT contents for a given profile change
+#define LUT_CACHE_VERSION 2
 
 static const cmsCIExyY srgb_whitepoint = { 0.3127, 0.3291, 1 };
 
@@ -12,37 +25,92 @@ static const cmsCIExyYTRIPLE srgb_primaries = {
 	.Blue = { 0.15, 0.06, 1},
 };
 
+// Header of a LUT cache file, followed by the profile_size bytes of the ICC
+// profile and the 3 * dim_len³ LUT floats
+struct lut_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t lcms_version;
+	uint64_t profile_size;
+	uint64_t dim_len;
+};
+
+static const char lut_cache_magic[8] = "wlrlut3d";
+
 static void handle_lcms_error(cmsContext ctx, cmsUInt32Number code, const char *text) {
 	wlr_log(WLR_ERROR, "[lcms] %s", text);
 }
 
-struct wlr_color_transform *wlr_color_transform_init_linear_to_icc(
-		const void *data, size_t size) {
-	struct wlr_color_transform_lut3d *tx = NULL;
+// The cache is opt-in, the compositor picks where it lives
+static bool get_cache_path(char *path, size_t size, const void *data,
+		size_t data_size) {
+	const char *dir = getenv("WLR_ICC_CACHE_DIR");
+	if (dir == NULL || dir[0] != '/') {
+		return false;
+	}
 
-	cmsContext ctx = cmsCreateContext(NULL, NULL);
-	if (ctx == NULL) {
-		wlr_log(WLR_ERROR, "cmsCreateContext failed");
+	int n = snprintf(path, size, "%s/icc-%016" PRIx64 ".lut", dir,
+		hash_fnv1a(HASH_FNV1A_INIT, data, data_size));
+	return n > 0 && (size_t)n < size;
+}
+
+static float *read_cached_lut(const char *path,
+		const struct lut_cache_header *expected, const void *profile) {
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
 		return NULL;
 	}
 
-	cmsSetLogErrorHandlerTHR(ctx, handle_lcms_error);
+	size_t lut_size = 3 * expected->dim_len * expected->dim_len *
+		expected->dim_len * sizeof(float);
+	size_t size = sizeof(*expected) + expected->profile_size + lut_size;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+		close(fd);
+		return NULL;
+	}
 
-	cmsHPROFILE icc_profile = cmsOpenProfileFromMemTHR(ctx, data, size);
-	if (icc_profile == NULL) {
-		wlr_log(WLR_ERROR, "cmsOpenProfileFromMemTHR failed");
-		goto out_ctx;
+	void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return NULL;
 	}
 
-	if (cmsGetDeviceClass(icc_profile) != cmsSigDisplayClass) {
-		wlr_log(WLR_ERROR, "ICC profile must have the Display device class");
-		goto out_icc_profile;
+	// Only trust the LUT if it was built from the exact same profile
+	const char *cached_profile = (const char *)data + sizeof(*expected);
+	float *lut_3d = NULL;
+	if (memcmp(data, expected, sizeof(*expected)) == 0 &&
+			memcmp(cached_profile, profile, expected->profile_size) == 0) {
+		lut_3d = malloc(lut_size);
+		if (lut_3d != NULL) {
+			memcpy(lut_3d, cached_profile + expected->profile_size, lut_size);
+		}
+	}
+	munmap(data, size);
+	return lut_3d;
+}
+
+static void write_cached_lut(const char *path,
+		const struct lut_cache_header *header, const void *profile,
+		const float *lut_3d) {
+	size_t lut_len = 3 * header->dim_len * header->dim_len * header->dim_len;
+	struct iovec iov[] = {
+		{ .iov_base = (void *)header, .iov_len = sizeof(*header) },
+		{ .iov_base = (void *)profile, .iov_len = header->profile_size },
+		{ .iov_base = (void *)lut_3d, .iov_len = lut_len * sizeof(float) },
+	};
+	if (!write_file_atomic(path, iov, sizeof(iov) / sizeof(iov[0]))) {
+		wlr_log_errno(WLR_ERROR, "Failed to write ICC LUT cache file %s", path);
 	}
+}
+
+static float *build_lut(cmsContext ctx, cmsHPROFILE icc_profile, size_t dim_len) {
+	float *lut_3d = NULL;
 
 	cmsToneCurve *linear_tone_curve = cmsBuildGamma(ctx, 1);
 	if (linear_tone_curve == NULL) {
 		wlr_log(WLR_ERROR, "cmsBuildGamma failed");
-		goto out_icc_profile;
+		return NULL;
 	}
 
 	cmsToneCurve *linear_tf[] = {
@@ -65,39 +133,107 @@ struct wlr_color_transform *wlr_color_transform_init_linear_to_icc(
 		goto out_srgb_profile;
 	}
 
-	size_t dim_len = 33;
-	float *lut_3d = calloc(3 * dim_len * dim_len * dim_len, sizeof(float));
-	if (lut_3d == NULL) {
+	size_t len = dim_len * dim_len * dim_len;
+	float *lattice = malloc(3 * len * sizeof(float));
+	lut_3d = malloc(3 * len * sizeof(float));
+	if (lattice == NULL || lut_3d == NULL) {
 		wlr_log_errno(WLR_ERROR, "Allocation failed");
-		goto out_lcms_tr;
+		free(lut_3d);
+		lut_3d = NULL;
+		goto out_lattice;
 	}
 
+	// The lattice is laid out in the same order as the LUT, so the whole
+	// table can be computed with a single transform call
 	float factor = 1.0f / (dim_len - 1);
+	float *in = lattice;
 	for (size_t b_index = 0; b_index < dim_len; b_index++) {
 		for (size_t g_index = 0; g_index < dim_len; g_index++) {
 			for (size_t r_index = 0; r_index < dim_len; r_index++) {
-				float rgb_in[3] = {
-					r_index * factor,
-					g_index * factor,
-					b_index * factor,
-				};
-				float rgb_out[3];
-				// TODO: use a single call to cmsDoTransform for the entire calculation?
-				// this does require allocating an extra temp buffer
-				cmsDoTransform(lcms_tr, rgb_in, rgb_out, 1);
-
-				size_t offset = 3 * (r_index + dim_len * g_index + dim_len * dim_len * b_index);
-				// TODO: maybe clamp values to [0.0, 1.0] here?
-				lut_3d[offset] = rgb_out[0];
-				lut_3d[offset + 1] = rgb_out[1];
-				lut_3d[offset + 2] = rgb_out[2];
+				in[0] = r_index * factor;
+				in[1] = g_index * factor;
+				in[2] = b_index * factor;
+				in += 3;
 			}
 		}
 	}
+	// TODO: maybe clamp values to [0.0, 1.0] here?
+	cmsDoTransform(lcms_tr, lattice, lut_3d, len);
 
-	tx = calloc(1, sizeof(struct wlr_color_transform_lut3d));
+out_lattice:
+	free(lattice);
+	cmsDeleteTransform(lcms_tr);
+out_srgb_profile:
+	cmsCloseProfile(srgb_profile);
+out_linear_tone_curve:
+	cmsFreeToneCurve(linear_tone_curve);
+	return lut_3d;
+}
+
+static float *create_lut(const void *data, size_t size, size_t dim_len) {
+	float *lut_3d = NULL;
+
+	cmsContext ctx = cmsCreateContext(NULL, NULL);
+	if (ctx == NULL) {
+		wlr_log(WLR_ERROR, "cmsCreateContext failed");
+		return NULL;
+	}
+
+	cmsSetLogErrorHandlerTHR(ctx, handle_lcms_error);
+
+	cmsHPROFILE icc_profile = cmsOpenProfileFromMemTHR(ctx, data, size);
+	if (icc_profile == NULL) {
+		wlr_log(WLR_ERROR, "cmsOpenProfileFromMemTHR failed");
+		goto out_ctx;
+	}
+
+	if (cmsGetDeviceClass(icc_profile) != cmsSigDisplayClass) {
+		wlr_log(WLR_ERROR, "ICC profile must have the Display device class");
+		goto out_icc_profile;
+	}
+
+	lut_3d = build_lut(ctx, icc_profile, dim_len);
+
+out_icc_profile:
+	cmsCloseProfile(icc_profile);
+out_ctx:
+	cmsDeleteContext(ctx);
+	return lut_3d;
+}
+
+struct wlr_color_transform *wlr_color_transform_init_linear_to_icc(
+		const void *data, size_t size) {
+	size_t dim_len = 33;
+
+	struct lut_cache_header header = {
+		.version = LUT_CACHE_VERSION,
+		.lcms_version = cmsGetEncodedCMMversion(),
+		.profile_size = size,
+		.dim_len = dim_len,
+	};
+	memcpy(header.magic, lut_cache_magic, sizeof(header.magic));
+
+	char cache_path[PATH_MAX];
+	bool have_cache = get_cache_path(cache_path, sizeof(cache_path), data, size);
+
+	float *lut_3d = NULL;
+	if (have_cache) {
+		lut_3d = read_cached_lut(cache_path, &header, data);
+	}
+	if (lut_3d == NULL) {
+		lut_3d = create_lut(data, size, dim_len);
+		if (lut_3d == NULL) {
+			return NULL;
+		}
+		if (have_cache) {
+			write_cached_lut(cache_path, &header, data, lut_3d);
+		}
+	}
+
+	struct wlr_color_transform_lut3d *tx = calloc(1, sizeof(*tx));
 	if (!tx) {
-		goto out_lcms_tr;
+		free(lut_3d);
+		return NULL;
 	}
 	tx->base.type = COLOR_TRANSFORM_LUT_3D;
 	tx->dim_len = dim_len;
@@ -105,15 +241,5 @@ struct wlr_color_transform *wlr_color_transform_init_linear_to_icc(
 	tx->base.ref_count = 1;
 	wlr_addon_set_init(&tx->base.addons);
 
-out_lcms_tr:
-	cmsDeleteTransform(lcms_tr);
-out_linear_tone_curve:
-	cmsFreeToneCurve(linear_tone_curve);
-out_srgb_profile:
-	cmsCloseProfile(srgb_profile);
-out_icc_profile:
-	cmsCloseProfile(icc_profile);
-out_ctx:
-	cmsDeleteContext(ctx);
 	return &tx->base;
 }
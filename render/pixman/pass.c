@@ -1,8 +1,13 @@
 #include <assert.h>
+#include <math.h>
 #include <stdlib.h>
+#include <wlr/render/color.h>
+#include <wlr/util/log.h>
+#include "render/color.h"
 #include "render/pixman.h"
 
 static const struct wlr_render_pass_impl render_pass_impl;
+static const struct wlr_addon_interface pixman_color_transform_impl;
 
 static struct wlr_pixman_render_pass *get_render_pass(struct wlr_render_pass *wlr_pass) {
 	assert(wlr_pass->impl == &render_pass_impl);
@@ -16,9 +21,396 @@ static struct wlr_pixman_texture *get_texture(struct wlr_texture *wlr_texture) {
 	return texture;
 }
 
+static float color_to_linear(float non_linear) {
+	// See https://www.w3.org/Graphics/Color/srgb
+	return (non_linear > 0.04045) ?
+		pow((non_linear + 0.055) / 1.055, 2.4) :
+		non_linear / 12.92;
+}
+
+void pixman_color_transform_destroy(struct wlr_addon *addon) {
+	struct wlr_pixman_color_transform *transform =
+		wl_container_of(addon, transform, addon);
+	for (size_t i = 0; i <= PIXMAN_LUT_MAX_CHANNEL_BITS; i++) {
+		free(transform->decode[i]);
+	}
+	wl_list_remove(&transform->link);
+	wlr_addon_finish(&transform->addon);
+	free(transform);
+}
+
+static const struct wlr_addon_interface pixman_color_transform_impl = {
+	.name = "pixman_color_transform",
+	.destroy = pixman_color_transform_destroy,
+};
+
+static struct wlr_pixman_color_transform *get_color_transform(
+		struct wlr_pixman_renderer *renderer,
+		struct wlr_color_transform_lut3d *lut_3d) {
+	struct wlr_addon *a = wlr_addon_find(&lut_3d->base.addons, renderer,
+		&pixman_color_transform_impl);
+	if (a != NULL) {
+		struct wlr_pixman_color_transform *transform =
+			wl_container_of(a, transform, addon);
+		return transform;
+	}
+
+	struct wlr_pixman_color_transform *transform = calloc(1, sizeof(*transform));
+	if (transform == NULL) {
+		return NULL;
+	}
+
+	wlr_addon_init(&transform->addon, &lut_3d->base.addons, renderer,
+		&pixman_color_transform_impl);
+	wl_list_insert(&renderer->color_transforms, &transform->link);
+
+	return transform;
+}
+
+/**
+ * Decoding a channel is the same for every pixel, so do it once per channel
+ * value and bit depth instead of per pixel in the inner loop.
+ */
+static const struct wlr_pixman_lut_decode *get_lut_decode(
+		struct wlr_pixman_color_transform *transform,
+		const struct wlr_color_transform_lut3d *lut_3d, int bits) {
+	if (transform->decode[bits] != NULL) {
+		return transform->decode[bits];
+	}
+
+	size_t len = (size_t)1 << bits;
+	struct wlr_pixman_lut_decode *decode = calloc(len, sizeof(*decode));
+	if (decode == NULL) {
+		return NULL;
+	}
+
+	size_t max_index = lut_3d->dim_len - 1;
+	for (size_t i = 0; i < len; i++) {
+		float pos = color_to_linear(i / (float)(len - 1)) * max_index;
+		size_t index = (size_t)pos;
+		if (index > max_index - 1) {
+			index = max_index - 1;
+		}
+		decode[i].index = index;
+		decode[i].weight = pos - index;
+	}
+
+	transform->decode[bits] = decode;
+	return decode;
+}
+
+// Position and width of the channels of a packed pixel format
+struct channel_layout {
+	int bpp;
+	int shift[4]; // red, green, blue, alpha
+	int bits[4]; // alpha has 0 bits if the format has no alpha channel
+};
+
+static bool get_channel_layout(pixman_format_code_t format,
+		struct channel_layout *layout) {
+	int bpp = PIXMAN_FORMAT_BPP(format);
+	int r = PIXMAN_FORMAT_R(format), g = PIXMAN_FORMAT_G(format);
+	int b = PIXMAN_FORMAT_B(format), a = PIXMAN_FORMAT_A(format);
+	if ((bpp != 16 && bpp != 32) || r > PIXMAN_LUT_MAX_CHANNEL_BITS ||
+			g > PIXMAN_LUT_MAX_CHANNEL_BITS || b > PIXMAN_LUT_MAX_CHANNEL_BITS ||
+			r == 0 || g == 0 || b == 0) {
+		return false;
+	}
+
+	*layout = (struct channel_layout){
+		.bpp = bpp,
+		.bits = { r, g, b, a },
+	};
+	switch (PIXMAN_FORMAT_TYPE(format)) {
+	case PIXMAN_TYPE_ARGB:
+		layout->shift[2] = 0;
+		layout->shift[1] = b;
+		layout->shift[0] = b + g;
+		layout->shift[3] = b + g + r;
+		return true;
+	case PIXMAN_TYPE_ABGR:
+		layout->shift[0] = 0;
+		layout->shift[1] = r;
+		layout->shift[2] = r + g;
+		layout->shift[3] = r + g + b;
+		return true;
+	case PIXMAN_TYPE_BGRA:
+		layout->shift[2] = bpp - b;
+		layout->shift[1] = bpp - b - g;
+		layout->shift[0] = bpp - b - g - r;
+		layout->shift[3] = 0;
+		return true;
+	case PIXMAN_TYPE_RGBA:
+		layout->shift[0] = bpp - r;
+		layout->shift[1] = bpp - r - g;
+		layout->shift[2] = bpp - r - g - b;
+		layout->shift[3] = 0;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static uint32_t unpremultiply(uint32_t value, uint32_t alpha,
+		uint32_t max_alpha, uint32_t max_value) {
+	if (alpha == max_alpha) {
+		return value;
+	}
+	uint32_t v = (value * max_alpha + alpha / 2) / alpha;
+	return v > max_value ? max_value : v;
+}
+
+static uint32_t encode_channel(float value, uint32_t alpha,
+		uint32_t max_alpha, uint32_t max_value) {
+	uint32_t limit = (max_value * alpha + max_alpha / 2) / max_alpha;
+	float v = value * ((float)(max_value * alpha) / max_alpha) + 0.5f;
+	if (v <= 0) {
+		return 0;
+	}
+	return v >= limit ? limit : (uint32_t)v;
+}
+
+/**
+ * Look up an sRGB-encoded color in the 3D LUT, using tetrahedral
+ * interpolation between the 4 lattice points around it.
+ */
+static void lut3d_lookup(const struct wlr_color_transform_lut3d *lut_3d,
+		const struct wlr_pixman_lut_decode *r,
+		const struct wlr_pixman_lut_decode *g,
+		const struct wlr_pixman_lut_decode *b, float out[static 3]) {
+	size_t dim = lut_3d->dim_len;
+	size_t sr = 3, sg = 3 * dim, sb = 3 * dim * dim;
+
+	float fr = r->weight;
+	float fg = g->weight;
+	float fb = b->weight;
+	const float *c000 = &lut_3d->lut_3d[r->index * sr + g->index * sg +
+		b->index * sb];
+	const float *c111 = c000 + sr + sg + sb;
+
+	// Offsets of the two intermediate vertices of the tetrahedron and the
+	// weights of all four vertices
+	size_t v1, v2;
+	float w0, w1, w2, w3;
+	if (fr >= fg) {
+		if (fg >= fb) {
+			v1 = sr; v2 = sr + sg;
+			w0 = 1 - fr; w1 = fr - fg; w2 = fg - fb; w3 = fb;
+		} else if (fr >= fb) {
+			v1 = sr; v2 = sr + sb;
+			w0 = 1 - fr; w1 = fr - fb; w2 = fb - fg; w3 = fg;
+		} else {
+			v1 = sb; v2 = sr + sb;
+			w0 = 1 - fb; w1 = fb - fr; w2 = fr - fg; w3 = fg;
+		}
+	} else {
+		if (fb >= fg) {
+			v1 = sb; v2 = sg + sb;
+			w0 = 1 - fb; w1 = fb - fg; w2 = fg - fr; w3 = fr;
+		} else if (fb >= fr) {
+			v1 = sg; v2 = sg + sb;
+			w0 = 1 - fg; w1 = fg - fb; w2 = fb - fr; w3 = fr;
+		} else {
+			v1 = sg; v2 = sr + sg;
+			w0 = 1 - fg; w1 = fg - fr; w2 = fr - fb; w3 = fb;
+		}
+	}
+
+	for (size_t i = 0; i < 3; i++) {
+		out[i] = w0 * c000[i] + w1 * c000[v1 + i] + w2 * c000[v2 + i] +
+			w3 * c111[i];
+	}
+}
+
+// Rows per task when spreading a color transform over worker threads
+#define LUT_TASK_ROWS 16
+// Below this many pixels, starting the workers costs more than it saves
+#define LUT_PARALLEL_MIN_PIXELS (256 * 256)
+
+struct lut_job {
+	const struct wlr_color_transform_lut3d *lut_3d;
+	struct channel_layout layout;
+	const struct wlr_pixman_lut_decode *decode[3];
+	uint8_t *data;
+	int stride;
+
+	pixman_box32_t *tasks; // bands of at most LUT_TASK_ROWS rows
+};
+
+static uint32_t lut_job_transform_pixel(const struct lut_job *job, uint32_t px) {
+	const struct channel_layout *layout = &job->layout;
+	uint32_t max_alpha = layout->bits[3] > 0 ? (1u << layout->bits[3]) - 1 : 1;
+	uint32_t alpha = layout->bits[3] > 0 ?
+		(px >> layout->shift[3]) & max_alpha : max_alpha;
+	if (alpha == 0) {
+		return px;
+	}
+
+	uint32_t result = px;
+	const struct wlr_pixman_lut_decode *decoded[3];
+	for (size_t i = 0; i < 3; i++) {
+		uint32_t max = (1u << layout->bits[i]) - 1;
+		uint32_t v = unpremultiply((px >> layout->shift[i]) & max, alpha,
+			max_alpha, max);
+		decoded[i] = &job->decode[i][v];
+		result &= ~(max << layout->shift[i]);
+	}
+
+	float rgb[3];
+	lut3d_lookup(job->lut_3d, decoded[0], decoded[1], decoded[2], rgb);
+	for (size_t i = 0; i < 3; i++) {
+		uint32_t max = (1u << layout->bits[i]) - 1;
+		result |= encode_channel(rgb[i], alpha, max_alpha, max) << layout->shift[i];
+	}
+	return result;
+}
+
+static void lut_job_run_task(void *data, size_t task) {
+	const struct lut_job *job = data;
+	const pixman_box32_t *box = &job->tasks[task];
+
+	// Composited content is mostly runs of identical pixels, so remember
+	// the last conversion
+	uint32_t last_in = 0, last_out = 0;
+	bool have_last = false;
+
+	for (int y = box->y1; y < box->y2; y++) {
+		uint8_t *row = job->data + (size_t)y * job->stride;
+		for (int x = box->x1; x < box->x2; x++) {
+			uint32_t px = job->layout.bpp == 32 ?
+				((uint32_t *)row)[x] : ((uint16_t *)row)[x];
+			uint32_t result;
+			if (have_last && px == last_in) {
+				result = last_out;
+			} else {
+				result = lut_job_transform_pixel(job, px);
+				last_in = px;
+				last_out = result;
+				have_last = true;
+			}
+
+			if (job->layout.bpp == 32) {
+				((uint32_t *)row)[x] = result;
+			} else {
+				((uint16_t *)row)[x] = result;
+			}
+		}
+	}
+}
+
+static void apply_color_transform_lut3d(struct wlr_pixman_render_pass *pass,
+		struct wlr_color_transform_lut3d *lut_3d) {
+	struct wlr_pixman_renderer *renderer = pass->buffer->renderer;
+	pixman_image_t *image = pass->buffer->image;
+
+	struct lut_job job = {
+		.lut_3d = lut_3d,
+		.data = (uint8_t *)pixman_image_get_data(image),
+		.stride = pixman_image_get_stride(image),
+	};
+	// Checked when beginning the pass
+	if (!get_channel_layout(pixman_image_get_format(image), &job.layout)) {
+		return;
+	}
+	if (lut_3d->dim_len < 2) {
+		return;
+	}
+
+	struct wlr_pixman_color_transform *transform =
+		get_color_transform(renderer, lut_3d);
+	if (transform == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate pixman color transform");
+		return;
+	}
+	for (size_t i = 0; i < 3; i++) {
+		job.decode[i] = get_lut_decode(transform, lut_3d, job.layout.bits[i]);
+		if (job.decode[i] == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate pixman color transform");
+			return;
+		}
+	}
+
+	const pixman_region32_t *region = rect_union_evaluate(&pass->updated_region);
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+
+	size_t tasks_len = 0;
+	uint64_t pixels = 0;
+	for (int i = 0; i < rects_len; i++) {
+		int height = rects[i].y2 - rects[i].y1;
+		tasks_len += (height + LUT_TASK_ROWS - 1) / LUT_TASK_ROWS;
+		pixels += (uint64_t)height * (rects[i].x2 - rects[i].x1);
+	}
+	if (tasks_len == 0) {
+		return;
+	}
+	job.tasks = calloc(tasks_len, sizeof(*job.tasks));
+	if (job.tasks == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate color transform tasks");
+		return;
+	}
+
+	size_t task = 0;
+	for (int i = 0; i < rects_len; i++) {
+		for (int y = rects[i].y1; y < rects[i].y2; y += LUT_TASK_ROWS) {
+			int y2 = y + LUT_TASK_ROWS;
+			job.tasks[task++] = (pixman_box32_t){
+				.x1 = rects[i].x1,
+				.y1 = y,
+				.x2 = rects[i].x2,
+				.y2 = y2 < rects[i].y2 ? y2 : rects[i].y2,
+			};
+		}
+	}
+
+	struct wlr_pixman_workers *workers = NULL;
+	if (pixels >= LUT_PARALLEL_MIN_PIXELS) {
+		if (!renderer->workers_started) {
+			renderer->workers = pixman_workers_create();
+			renderer->workers_started = true;
+		}
+		workers = renderer->workers;
+	}
+	pixman_workers_run(workers, lut_job_run_task, &job, tasks_len);
+
+	free(job.tasks);
+}
+
+static void render_pass_mark_box_updated(struct wlr_pixman_render_pass *pass,
+		const struct wlr_box *box, const pixman_region32_t *clip) {
+	if (pass->color_transform == NULL) {
+		return;
+	}
+
+	// The transform is applied in place, so the region must not cover
+	// anything which wasn't drawn to during this pass
+	struct wlr_buffer *buffer = pass->buffer->buffer;
+	pixman_region32_t region;
+	pixman_region32_init_rect(&region, box->x, box->y, box->width, box->height);
+	pixman_region32_intersect_rect(&region, &region,
+		0, 0, buffer->width, buffer->height);
+	if (clip != NULL) {
+		pixman_region32_intersect(&region, &region, clip);
+	}
+
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(&region, &rects_len);
+	for (int i = 0; i < rects_len; i++) {
+		rect_union_add(&pass->updated_region, rects[i]);
+	}
+	pixman_region32_fini(&region);
+}
+
 static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	struct wlr_pixman_render_pass *pass = get_render_pass(wlr_pass);
 
+	if (pass->color_transform != NULL) {
+		apply_color_transform_lut3d(pass,
+			wlr_color_transform_lut3d_from_base(pass->color_transform));
+		wlr_color_transform_unref(pass->color_transform);
+	}
+	rect_union_finish(&pass->updated_region);
+
 	wlr_buffer_end_data_ptr_access(pass->buffer->buffer);
 	wlr_buffer_unlock(pass->buffer->buffer);
 	free(pass);
@@ -61,6 +453,7 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 
 	struct wlr_box dst_box;
 	wlr_render_texture_options_get_dst_box(options, &dst_box);
+	render_pass_mark_box_updated(pass, &dst_box, options->clip);
 
 	pixman_image_t *mask = NULL;
 	float alpha = wlr_render_texture_options_get_alpha(options);
@@ -204,6 +597,7 @@ static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
 	struct wlr_pixman_buffer *buffer = pass->buffer;
 	struct wlr_box box;
 	wlr_render_rect_options_get_box(options, pass->buffer->buffer, &box);
+	render_pass_mark_box_updated(pass, &box, options->clip);
 
 	pixman_op_t op = get_pixman_blending(options->color.a == 1 ?
 		WLR_RENDER_BLEND_MODE_NONE : options->blend_mode);
@@ -232,7 +626,7 @@ static const struct wlr_render_pass_impl render_pass_impl = {
 };
 
 struct wlr_pixman_render_pass *begin_pixman_render_pass(
-		struct wlr_pixman_buffer *buffer) {
+		struct wlr_pixman_buffer *buffer, const struct wlr_buffer_pass_options *options) {
 	struct wlr_pixman_render_pass *pass = calloc(1, sizeof(*pass));
 	if (pass == NULL) {
 		return NULL;
@@ -246,8 +640,22 @@ struct wlr_pixman_render_pass *begin_pixman_render_pass(
 		return NULL;
 	}
 
+	// Buffers are already sRGB-encoded, so only 3D LUTs need any work
+	if (options != NULL && options->color_transform != NULL &&
+			options->color_transform->type == COLOR_TRANSFORM_LUT_3D) {
+		struct channel_layout layout;
+		if (!get_channel_layout(pixman_image_get_format(buffer->image), &layout)) {
+			wlr_log(WLR_ERROR, "Color transforms are not supported on this format");
+			wlr_buffer_end_data_ptr_access(buffer->buffer);
+			free(pass);
+			return NULL;
+		}
+		pass->color_transform = wlr_color_transform_ref(options->color_transform);
+	}
+
 	wlr_buffer_lock(buffer->buffer);
 	pass->buffer = buffer;
+	rect_union_init(&pass->updated_region);
 
 	return pass;
 }
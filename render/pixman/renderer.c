@@ -287,6 +287,13 @@ static void pixman_destroy(struct wlr_renderer *wlr_renderer) {
 		wlr_texture_destroy(&tex->wlr_texture);
 	}
 
+	struct wlr_pixman_color_transform *transform, *transform_tmp;
+	wl_list_for_each_safe(transform, transform_tmp,
+			&renderer->color_transforms, link) {
+		pixman_color_transform_destroy(&transform->addon);
+	}
+	pixman_workers_destroy(renderer->workers);
+
 	wlr_drm_format_set_finish(&renderer->drm_formats);
 
 	free(renderer);
@@ -304,7 +311,7 @@ static struct wlr_render_pass *pixman_begin_buffer_pass(struct wlr_renderer *wlr
 		return NULL;
 	}
 
-	struct wlr_pixman_render_pass *pass = begin_pixman_render_pass(buffer);
+	struct wlr_pixman_render_pass *pass = begin_pixman_render_pass(buffer, options);
 	if (pass == NULL) {
 		return NULL;
 	}
@@ -327,9 +334,10 @@ struct wlr_renderer *wlr_pixman_renderer_create(void) {
 
 	wlr_log(WLR_INFO, "Creating pixman renderer");
 	wlr_renderer_init(&renderer->wlr_renderer, &renderer_impl, WLR_BUFFER_CAP_DATA_PTR);
-	renderer->wlr_renderer.features.output_color_transform = false;
+	renderer->wlr_renderer.features.output_color_transform = true;
 	wl_list_init(&renderer->buffers);
 	wl_list_init(&renderer->textures);
+	wl_list_init(&renderer->color_transforms);
 
 	size_t len = 0;
 	const uint32_t *formats = get_pixman_drm_formats(&len);
@@ -0,0 +1,144 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "render/pixman.h"
+
+#define MAX_WORKERS 7
+
+struct wlr_pixman_workers {
+	pthread_mutex_t lock;
+	pthread_cond_t start; // broadcast when a job is posted or on stop
+	pthread_cond_t done; // signalled when the last worker finishes a job
+	pthread_t threads[MAX_WORKERS];
+	size_t threads_len;
+
+	// Current job, posted under the lock
+	uint64_t generation;
+	size_t busy; // workers which haven't finished the current job yet
+	bool stopping;
+	pixman_workers_func_t func;
+	void *data;
+	size_t tasks_len;
+	atomic_size_t next_task;
+};
+
+static void workers_run_tasks(struct wlr_pixman_workers *workers) {
+	size_t i;
+	while ((i = atomic_fetch_add(&workers->next_task, 1)) < workers->tasks_len) {
+		workers->func(workers->data, i);
+	}
+}
+
+static void *worker_run(void *data) {
+	struct wlr_pixman_workers *workers = data;
+	uint64_t generation = 0;
+
+	pthread_mutex_lock(&workers->lock);
+	while (true) {
+		while (workers->generation == generation && !workers->stopping) {
+			pthread_cond_wait(&workers->start, &workers->lock);
+		}
+		if (workers->stopping) {
+			break;
+		}
+		generation = workers->generation;
+		pthread_mutex_unlock(&workers->lock);
+
+		workers_run_tasks(workers);
+
+		pthread_mutex_lock(&workers->lock);
+		if (--workers->busy == 0) {
+			pthread_cond_signal(&workers->done);
+		}
+	}
+	pthread_mutex_unlock(&workers->lock);
+	return NULL;
+}
+
+struct wlr_pixman_workers *pixman_workers_create(void) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus <= 1) {
+		return NULL;
+	}
+
+	struct wlr_pixman_workers *workers = calloc(1, sizeof(*workers));
+	if (workers == NULL) {
+		return NULL;
+	}
+	pthread_mutex_init(&workers->lock, NULL);
+	pthread_cond_init(&workers->start, NULL);
+	pthread_cond_init(&workers->done, NULL);
+
+	// The calling thread takes part in every job
+	size_t threads_len = cpus - 1 < MAX_WORKERS ? cpus - 1 : MAX_WORKERS;
+
+	// Don't let workers receive signals meant for the compositor
+	sigset_t mask, prev_mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_SETMASK, &mask, &prev_mask);
+	for (size_t i = 0; i < threads_len; i++) {
+		if (pthread_create(&workers->threads[i], NULL, worker_run, workers) != 0) {
+			break;
+		}
+		workers->threads_len++;
+	}
+	pthread_sigmask(SIG_SETMASK, &prev_mask, NULL);
+
+	if (workers->threads_len == 0) {
+		wlr_log(WLR_ERROR, "Failed to start pixman worker threads");
+		pixman_workers_destroy(workers);
+		return NULL;
+	}
+	return workers;
+}
+
+void pixman_workers_destroy(struct wlr_pixman_workers *workers) {
+	if (workers == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&workers->lock);
+	workers->stopping = true;
+	pthread_cond_broadcast(&workers->start);
+	pthread_mutex_unlock(&workers->lock);
+
+	for (size_t i = 0; i < workers->threads_len; i++) {
+		pthread_join(workers->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&workers->done);
+	pthread_cond_destroy(&workers->start);
+	pthread_mutex_destroy(&workers->lock);
+	free(workers);
+}
+
+void pixman_workers_run(struct wlr_pixman_workers *workers,
+		pixman_workers_func_t func, void *data, size_t tasks_len) {
+	if (workers == NULL || tasks_len < 2) {
+		for (size_t i = 0; i < tasks_len; i++) {
+			func(data, i);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&workers->lock);
+	workers->func = func;
+	workers->data = data;
+	workers->tasks_len = tasks_len;
+	atomic_store(&workers->next_task, 0);
+	workers->busy = workers->threads_len;
+	workers->generation++;
+	pthread_cond_broadcast(&workers->start);
+	pthread_mutex_unlock(&workers->lock);
+
+	workers_run_tasks(workers);
+
+	pthread_mutex_lock(&workers->lock);
+	while (workers->busy > 0) {
+		pthread_cond_wait(&workers->done, &workers->lock);
+	}
+	pthread_mutex_unlock(&workers->lock);
+}
@@ -63,6 +63,11 @@ void wlr_output_state_set_adaptive_sync_enabled(struct wlr_output_state *state,
 	state->adaptive_sync_enabled = enabled;
 }
 
+void wlr_output_state_set_tearing_page_flip(struct wlr_output_state *state,
+		bool enabled) {
+	state->tearing_page_flip = enabled;
+}
+
 void wlr_output_state_set_render_format(struct wlr_output_state *state,
 		uint32_t format) {
 	state->committed |= WLR_OUTPUT_STATE_RENDER_FORMAT;
@@ -9,6 +9,7 @@
 #include <wlr/types/wlr_damage_ring.h>
 #include <wlr/types/wlr_gamma_control_v1.h>
 #include <wlr/types/wlr_linux_dmabuf_v1.h>
+#include <wlr/types/wlr_output_layer.h>
 #include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/log.h>
@@ -1483,6 +1484,17 @@ static void scene_handle_gamma_control_manager_v1_destroy(struct wl_listener *li
 	}
 }
 
+void wlr_scene_set_hidden_frame_interval(struct wlr_scene *scene,
+		int interval_ms) {
+	assert(interval_ms >= 0);
+	scene->hidden_frame_interval_ms = interval_ms;
+}
+
+void wlr_scene_set_max_output_layers(struct wlr_scene *scene,
+		size_t max_layers) {
+	scene->max_output_layers = max_layers;
+}
+
 void wlr_scene_set_gamma_control_manager_v1(struct wlr_scene *scene,
 	    struct wlr_gamma_control_manager_v1 *gamma_control) {
 	assert(scene->gamma_control_manager_v1 == NULL);
@@ -1685,6 +1697,15 @@ void wlr_scene_output_destroy(struct wlr_scene_output *scene_output) {
 	wl_list_remove(&scene_output->output_needs_frame.link);
 	wlr_drm_syncobj_timeline_unref(scene_output->in_timeline);
 	wl_array_release(&scene_output->render_list);
+
+	struct wlr_output_layer **layer;
+	wl_array_for_each(layer, &scene_output->layers) {
+		wlr_output_layer_destroy(*layer);
+	}
+	wl_array_release(&scene_output->layers);
+	wl_array_release(&scene_output->layer_states);
+	wl_array_release(&scene_output->offloaded_nodes);
+
 	free(scene_output);
 }
 
@@ -1816,6 +1837,17 @@ static void scene_buffer_send_dmabuf_feedback(const struct wlr_scene *scene,
 	wlr_linux_dmabuf_feedback_v1_finish(&feedback);
 }
 
+// Prefer the client's original buffer over our copy, if it's still around
+static struct wlr_buffer *scene_buffer_get_scanout_buffer(
+		struct wlr_scene_buffer *buffer) {
+	struct wlr_buffer *wlr_buffer = buffer->buffer;
+	struct wlr_client_buffer *client_buffer = wlr_client_buffer_get(wlr_buffer);
+	if (client_buffer != NULL && client_buffer->source != NULL && client_buffer->source->n_locks > 0) {
+		wlr_buffer = client_buffer->source;
+	}
+	return wlr_buffer;
+}
+
 static bool scene_entry_try_direct_scanout(struct render_list_entry *entry,
 		struct wlr_output_state *state, const struct render_data *data) {
 	struct wlr_scene_output *scene_output = data->output;
@@ -1886,13 +1918,7 @@ static bool scene_entry_try_direct_scanout(struct render_list_entry *entry,
 	scene_node_get_size(node, &pending.buffer_dst_box.width, &pending.buffer_dst_box.height);
 	transform_output_box(&pending.buffer_dst_box, data);
 
-	struct wlr_buffer *wlr_buffer = buffer->buffer;
-	struct wlr_client_buffer *client_buffer = wlr_client_buffer_get(wlr_buffer);
-	if (client_buffer != NULL && client_buffer->source != NULL && client_buffer->source->n_locks > 0) {
-		wlr_buffer = client_buffer->source;
-	}
-
-	wlr_output_state_set_buffer(&pending, wlr_buffer);
+	wlr_output_state_set_buffer(&pending, scene_buffer_get_scanout_buffer(buffer));
 	if (buffer->wait_timeline != NULL) {
 		wlr_output_state_set_wait_timeline(&pending, buffer->wait_timeline, buffer->wait_point);
 	}
@@ -1913,6 +1939,156 @@ static bool scene_entry_try_direct_scanout(struct render_list_entry *entry,
 	return true;
 }
 
+static bool scene_entry_can_offload(struct render_list_entry *entry,
+		const struct render_data *data) {
+	if (entry->node->type != WLR_SCENE_NODE_BUFFER ||
+			entry->highlight_transparent_region) {
+		return false;
+	}
+
+	// Output layers have no transform, opacity or wait timeline
+	struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(entry->node);
+	return buffer->buffer != NULL && buffer->opacity == 1 &&
+		buffer->transform == data->transform && buffer->wait_timeline == NULL;
+}
+
+/**
+ * Display the topmost offloaded_len entries of the render list on output
+ * layers and disable the remaining layers.
+ */
+static void scene_output_set_layers(struct wlr_scene_output *scene_output,
+		struct wlr_output_state *state, struct render_list_entry *list_data,
+		size_t offloaded_len, const struct render_data *data) {
+	size_t layers_len = scene_output->layers.size / sizeof(struct wlr_output_layer *);
+	if (layers_len == 0) {
+		return;
+	}
+	assert(offloaded_len <= layers_len);
+
+	struct wlr_output_layer **layers = scene_output->layers.data;
+	struct wlr_output_layer_state *layer_states = scene_output->layer_states.data;
+	for (size_t i = 0; i < layers_len; i++) {
+		layer_states[i] = (struct wlr_output_layer_state){ .layer = layers[i] };
+	}
+
+	// Layers are ordered from bottom to top, the render list from top to bottom
+	for (size_t i = 0; i < offloaded_len; i++) {
+		struct render_list_entry *entry = &list_data[offloaded_len - 1 - i];
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(entry->node);
+
+		struct wlr_box dst_box = {
+			.x = entry->x - scene_output->x,
+			.y = entry->y - scene_output->y,
+		};
+		scene_node_get_size(entry->node, &dst_box.width, &dst_box.height);
+		transform_output_box(&dst_box, data);
+
+		layer_states[i].buffer = scene_buffer_get_scanout_buffer(buffer);
+		layer_states[i].src_box = buffer->src_box;
+		layer_states[i].dst_box = dst_box;
+	}
+
+	wlr_output_state_set_layers(state, layer_states, layers_len);
+}
+
+/**
+ * Try to display the topmost buffer nodes on output layers. Returns the
+ * number of render list entries which the backend accepted, these must not
+ * be composited.
+ */
+static size_t scene_output_offload_layers(struct wlr_scene_output *scene_output,
+		struct wlr_output_state *state, struct render_list_entry *list_data,
+		size_t list_len, const struct render_data *data) {
+	size_t max_layers = scene_output->scene->max_output_layers;
+	size_t candidates_len = 0;
+	while (candidates_len < list_len && candidates_len < max_layers &&
+			scene_entry_can_offload(&list_data[candidates_len], data)) {
+		candidates_len++;
+	}
+	if (candidates_len == 0) {
+		return 0;
+	}
+
+	// Layers are created on demand and kept around, they're disabled
+	// whenever they aren't needed
+	size_t layers_len = scene_output->layers.size / sizeof(struct wlr_output_layer *);
+	while (layers_len < candidates_len) {
+		if (wl_array_add(&scene_output->layer_states,
+				sizeof(struct wlr_output_layer_state)) == NULL) {
+			break;
+		}
+		struct wlr_output_layer **layer =
+			wl_array_add(&scene_output->layers, sizeof(*layer));
+		if (layer == NULL) {
+			break;
+		}
+		*layer = wlr_output_layer_create(scene_output->output);
+		if (*layer == NULL) {
+			scene_output->layers.size -= sizeof(*layer);
+			break;
+		}
+		layers_len++;
+	}
+	if (candidates_len > layers_len) {
+		candidates_len = layers_len;
+	}
+
+	scene_output_set_layers(scene_output, state, list_data, candidates_len, data);
+	if (!wlr_output_test_state(scene_output->output, state)) {
+		scene_output_set_layers(scene_output, state, list_data, 0, data);
+		return 0;
+	}
+
+	// Rejected layers get composited below all layers, so only a run of
+	// accepted layers starting at the top can be offloaded
+	struct wlr_output_layer_state *layer_states = scene_output->layer_states.data;
+	size_t accepted_len = 0;
+	while (accepted_len < candidates_len &&
+			layer_states[candidates_len - 1 - accepted_len].accepted) {
+		accepted_len++;
+	}
+
+	if (accepted_len < candidates_len) {
+		scene_output_set_layers(scene_output, state, list_data, accepted_len, data);
+		if (accepted_len > 0 && !wlr_output_test_state(scene_output->output, state)) {
+			scene_output_set_layers(scene_output, state, list_data, 0, data);
+			accepted_len = 0;
+		}
+	}
+
+	return accepted_len;
+}
+
+/**
+ * Remember which nodes are offloaded. Returns true if this differs from the
+ * previous frame, in which case the composited contents changed everywhere
+ * these nodes are.
+ */
+static bool scene_output_update_offloaded(struct wlr_scene_output *scene_output,
+		struct render_list_entry *list_data, size_t offloaded_len) {
+	struct wl_array *nodes = &scene_output->offloaded_nodes;
+	bool changed = nodes->size != offloaded_len * sizeof(struct wlr_scene_node *);
+	for (size_t i = 0; !changed && i < offloaded_len; i++) {
+		struct wlr_scene_node **node = nodes->data;
+		changed = node[i] != list_data[i].node;
+	}
+	if (!changed) {
+		return false;
+	}
+
+	nodes->size = 0;
+	for (size_t i = 0; i < offloaded_len; i++) {
+		struct wlr_scene_node **node = wl_array_add(nodes, sizeof(*node));
+		if (node == NULL) {
+			// Force the next frame to be treated as changed
+			nodes->size = 0;
+			break;
+		}
+		*node = list_data[i].node;
+	}
+	return true;
+}
+
 bool wlr_scene_output_needs_frame(struct wlr_scene_output *scene_output) {
 	return scene_output->output->needs_frame ||
 		!pixman_region32_empty(&scene_output->pending_commit_damage) ||
@@ -2089,6 +2265,9 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 
 	wlr_output_state_set_damage(state, &scene_output->pending_commit_damage);
 
+	// Layers from a previous frame must be disabled unless they're used again
+	scene_output_set_layers(scene_output, state, list_data, 0, &render_data);
+
 	// We only want to try direct scanout if:
 	// - There is only one entry in the render list
 	// - There are no color transforms that need to be applied
@@ -2097,10 +2276,33 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		list_len == 1 && debug_damage != WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT &&
 		scene_entry_try_direct_scanout(&list_data[0], state, &render_data);
 
+	// The same conditions apply to output layers, which additionally can
+	// only be used for nodes on top of everything else. Software cursors and
+	// screen capture need everything in the composited buffer.
+	size_t offloaded_len = 0;
+	if (!scanout && options->color_transform == NULL &&
+			debug_damage != WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT &&
+			wlr_output_is_direct_scanout_allowed(output)) {
+		offloaded_len = scene_output_offload_layers(scene_output, state,
+			list_data, list_len, &render_data);
+	}
+	if (scene_output_update_offloaded(scene_output, list_data, offloaded_len)) {
+		scene_output_damage_whole(scene_output);
+		wlr_output_state_set_damage(state, &scene_output->pending_commit_damage);
+	}
+	for (size_t i = 0; i < offloaded_len; i++) {
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(list_data[i].node);
+		struct wlr_scene_output_sample_event sample_event = {
+			.output = scene_output,
+			.direct_scanout = true,
+		};
+		wl_signal_emit_mutable(&buffer->events.output_sample, &sample_event);
+	}
+
 	if (scene_output->prev_scanout != scanout) {
 		scene_output->prev_scanout = scanout;
-		wlr_log(WLR_DEBUG, "Direct scan-out %s",
-			scanout ? "enabled" : "disabled");
+		wlr_log(WLR_DEBUG, "Direct scan-out %s on %s",
+			scanout ? "enabled" : "disabled", output->name);
 	}
 
 	if (scanout) {
@@ -2202,7 +2404,7 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	});
 	pixman_region32_fini(&background);
 
-	for (int i = list_len - 1; i >= 0; i--) {
+	for (int i = list_len - 1; i >= (int)offloaded_len; i--) {
 		struct render_list_entry *entry = &list_data[i];
 		scene_entry_render(entry, &render_data);
 
@@ -2277,7 +2479,8 @@ void wlr_scene_timer_finish(struct wlr_scene_timer *timer) {
 }
 
 static void scene_node_send_frame_done(struct wlr_scene_node *node,
-		struct wlr_scene_output *scene_output, struct timespec *now) {
+		struct wlr_scene_output *scene_output, struct timespec *now,
+		int hidden_interval_ms) {
 	if (!node->enabled) {
 		return;
 	}
@@ -2288,20 +2491,30 @@ static void scene_node_send_frame_done(struct wlr_scene_node *node,
 
 		if (scene_buffer->primary_output == scene_output) {
 			wlr_scene_buffer_send_frame_done(scene_buffer, now);
+		} else if (scene_buffer->primary_output == NULL && hidden_interval_ms > 0) {
+			// Every output walks the tree, the first one to get here after
+			// the interval has elapsed sends the event
+			int64_t now_msec = timespec_to_msec(now);
+			if (now_msec - scene_buffer->hidden_frame_done_msec >= hidden_interval_ms) {
+				scene_buffer->hidden_frame_done_msec = now_msec;
+				wl_signal_emit_mutable(&scene_buffer->events.frame_done, now);
+			}
 		}
 	} else if (node->type == WLR_SCENE_NODE_TREE) {
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
 		struct wlr_scene_node *child;
 		wl_list_for_each(child, &scene_tree->children, link) {
-			scene_node_send_frame_done(child, scene_output, now);
+			scene_node_send_frame_done(child, scene_output, now,
+				hidden_interval_ms);
 		}
 	}
 }
 
 void wlr_scene_output_send_frame_done(struct wlr_scene_output *scene_output,
 		struct timespec *now) {
-	scene_node_send_frame_done(&scene_output->scene->tree.node,
-		scene_output, now);
+	struct wlr_scene *scene = scene_output->scene;
+	scene_node_send_frame_done(&scene->tree.node, scene_output, now,
+		scene->hidden_frame_interval_ms);
 }
 
 static void scene_output_for_each_scene_buffer(const struct wlr_box *output_box,
@@ -249,6 +249,20 @@ static void surface_update_damage(pixman_region32_t *buffer_damage,
 		struct wlr_surface_state *current, struct wlr_surface_state *pending) {
 	pixman_region32_clear(buffer_damage);
 
+	if (!pixman_region32_not_empty(&pending->surface_damage)) {
+		// Only buffer damage, nothing to convert
+		pixman_region32_copy(buffer_damage, &pending->buffer_damage);
+		return;
+	}
+	if (!pending->viewport.has_src && !pending->viewport.has_dst &&
+			pending->scale == 1 &&
+			pending->transform == WL_OUTPUT_TRANSFORM_NORMAL) {
+		// Surface-local coordinates are buffer-local coordinates
+		pixman_region32_union(buffer_damage,
+			&pending->buffer_damage, &pending->surface_damage);
+		return;
+	}
+
 	// Copy over surface damage + buffer damage
 	pixman_region32_t surface_damage;
 	pixman_region32_init(&surface_damage);
@@ -315,6 +329,12 @@ static void surface_synced_move_state(struct wlr_surface_synced *synced,
 	}
 }
 
+static void region_swap(pixman_region32_t *a, pixman_region32_t *b) {
+	pixman_region32_t tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
 /**
  * Overwrite state with a copy of the next state, then clear the next state.
  */
@@ -348,13 +368,14 @@ static void surface_state_move(struct wlr_surface_state *state,
 		next->buffer = NULL;
 	}
 	if (next->committed & WLR_SURFACE_STATE_SURFACE_DAMAGE) {
-		pixman_region32_copy(&state->surface_damage, &next->surface_damage);
+		// Swap instead of copying to avoid re-allocating the rectangles
+		region_swap(&state->surface_damage, &next->surface_damage);
 		pixman_region32_clear(&next->surface_damage);
 	} else {
 		pixman_region32_clear(&state->surface_damage);
 	}
 	if (next->committed & WLR_SURFACE_STATE_BUFFER_DAMAGE) {
-		pixman_region32_copy(&state->buffer_damage, &next->buffer_damage);
+		region_swap(&state->buffer_damage, &next->buffer_damage);
 		pixman_region32_clear(&next->buffer_damage);
 	} else {
 		pixman_region32_clear(&state->buffer_damage);
@@ -523,6 +544,9 @@ static void surface_commit_state(struct wlr_surface *surface,
 
 	surface_update_damage(&surface->buffer_damage, &surface->current, next);
 
+	bool had_buffer = wlr_surface_has_buffer(surface);
+	bool was_opaque = surface->opaque;
+
 	surface->previous.scale = surface->current.scale;
 	surface->previous.transform = surface->current.transform;
 	surface->previous.width = surface->current.width;
@@ -535,8 +559,20 @@ static void surface_commit_state(struct wlr_surface *surface,
 	if (invalid_buffer) {
 		surface_apply_damage(surface);
 	}
-	surface_update_opaque_region(surface);
-	surface_update_input_region(surface);
+
+	// Most commits only carry a new buffer and some damage: only recompute
+	// the opaque and input regions when one of their inputs has changed
+	bool size_changed = surface->current.width != surface->previous.width ||
+		surface->current.height != surface->previous.height;
+	if (size_changed || had_buffer != wlr_surface_has_buffer(surface) ||
+			was_opaque != surface->opaque ||
+			(surface->current.committed & WLR_SURFACE_STATE_OPAQUE_REGION)) {
+		surface_update_opaque_region(surface);
+	}
+	if (size_changed ||
+			(surface->current.committed & WLR_SURFACE_STATE_INPUT_REGION)) {
+		surface_update_input_region(surface);
+	}
 
 	struct wlr_subsurface *subsurface;
 	wl_list_for_each(subsurface, &surface->current.subsurfaces_below, current.link) {
@@ -1,8 +1,10 @@
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <wlr/types/wlr_idle_notify_v1.h>
 #include <wlr/types/wlr_seat.h>
 #include "ext-idle-notify-v1-protocol.h"
+#include "util/time.h"
 
 #define IDLE_NOTIFIER_VERSION 1
 
@@ -13,7 +15,7 @@ struct wlr_idle_notification_v1 {
 	struct wlr_seat *seat;
 
 	uint32_t timeout_ms;
-	struct wl_event_source *timer;
+	int64_t last_activity_msec;
 
 	bool idle;
 
@@ -61,9 +63,58 @@ static void notification_set_idle(struct wlr_idle_notification_v1 *notification,
 	notification->idle = idle;
 }
 
-static int notification_handle_timer(void *data) {
-	struct wlr_idle_notification_v1 *notification = data;
-	notification_set_idle(notification, true);
+// Arm the notifier timer for the earliest pending deadline, if any
+static void notifier_update_timer(struct wlr_idle_notifier_v1 *notifier,
+		int64_t now) {
+	bool found = false;
+	int64_t deadline = 0;
+	if (!notifier->inhibited) {
+		struct wlr_idle_notification_v1 *notification;
+		wl_list_for_each(notification, &notifier->notifications, link) {
+			if (notification->idle || notification->timeout_ms == 0) {
+				continue;
+			}
+			int64_t d = notification->last_activity_msec + notification->timeout_ms;
+			if (!found || d < deadline) {
+				deadline = d;
+				found = true;
+			}
+		}
+	}
+
+	if (!found) {
+		if (notifier->timer_armed) {
+			wl_event_source_timer_update(notifier->timer, 0);
+			notifier->timer_armed = false;
+		}
+		return;
+	}
+
+	// A zero delay would disarm the timer
+	int64_t delay = deadline - now;
+	if (delay < 1) {
+		delay = 1;
+	} else if (delay > INT_MAX) {
+		delay = INT_MAX;
+	}
+	wl_event_source_timer_update(notifier->timer, delay);
+	notifier->timer_armed = true;
+}
+
+static int notifier_handle_timer(void *data) {
+	struct wlr_idle_notifier_v1 *notifier = data;
+	notifier->timer_armed = false;
+
+	int64_t now = get_current_time_msec();
+	struct wlr_idle_notification_v1 *notification;
+	wl_list_for_each(notification, &notifier->notifications, link) {
+		if (!notification->idle && notification->timeout_ms > 0 &&
+				now - notification->last_activity_msec >= notification->timeout_ms) {
+			notification_set_idle(notification, true);
+		}
+	}
+
+	notifier_update_timer(notifier, now);
 	return 0;
 }
 
@@ -73,33 +124,30 @@ static void notification_destroy(struct wlr_idle_notification_v1 *notification)
 	}
 	wl_list_remove(&notification->link);
 	wl_list_remove(&notification->seat_destroy.link);
-	if (notification->timer != NULL) {
-		wl_event_source_remove(notification->timer);
-	}
 	wl_resource_set_user_data(notification->resource, NULL); // make inert
 	free(notification);
 }
 
-static void notification_reset_timer(struct wlr_idle_notification_v1 *notification) {
+// Restart the idle countdown. The caller is responsible for updating the
+// notifier timer.
+static void notification_reset(struct wlr_idle_notification_v1 *notification,
+		int64_t now) {
+	notification->last_activity_msec = now;
 	if (notification->notifier->inhibited) {
 		notification_set_idle(notification, false);
-		if (notification->timer != NULL) {
-			wl_event_source_timer_update(notification->timer, 0);
-		}
-		return;
-	}
-
-	if (notification->timer != NULL) {
-		wl_event_source_timer_update(notification->timer,
-			notification->timeout_ms);
-	} else {
+	} else if (notification->timeout_ms == 0) {
 		notification_set_idle(notification, true);
 	}
 }
 
-static void notification_handle_activity(struct wlr_idle_notification_v1 *notification) {
+// Returns true if the notification got a new deadline, which may be earlier
+// than the one the notifier timer is armed for
+static bool notification_handle_activity(struct wlr_idle_notification_v1 *notification,
+		int64_t now) {
+	bool resumed = notification->idle && notification->timeout_ms > 0;
 	notification_set_idle(notification, false);
-	notification_reset_timer(notification);
+	notification_reset(notification, now);
+	return resumed;
 }
 
 static void notification_handle_seat_destroy(struct wl_listener *listener,
@@ -149,25 +197,15 @@ static void notifier_handle_get_idle_notification(struct wl_client *client,
 	notification->timeout_ms = timeout;
 	notification->seat = seat_client->seat;
 
-	if (timeout > 0) {
-		struct wl_display *display = wl_client_get_display(client);
-		struct wl_event_loop *loop = wl_display_get_event_loop(display);
-		notification->timer = wl_event_loop_add_timer(loop,
-			notification_handle_timer, notification);
-		if (notification->timer == NULL) {
-			free(notification);
-			wl_client_post_no_memory(client);
-			return;
-		}
-	}
-
 	notification->seat_destroy.notify = notification_handle_seat_destroy;
 	wl_signal_add(&seat_client->seat->events.destroy, &notification->seat_destroy);
 
 	wl_resource_set_user_data(resource, notification);
 	wl_list_insert(&notifier->notifications, &notification->link);
 
-	notification_reset_timer(notification);
+	int64_t now = get_current_time_msec();
+	notification_reset(notification, now);
+	notifier_update_timer(notifier, now);
 }
 
 static const struct ext_idle_notifier_v1_interface notifier_impl = {
@@ -192,6 +230,7 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_idle_notifier_v1 *notifier =
 		wl_container_of(listener, notifier, display_destroy);
 	wl_global_destroy(notifier->global);
+	wl_event_source_remove(notifier->timer);
 	free(notifier);
 }
 
@@ -211,6 +250,14 @@ struct wlr_idle_notifier_v1 *wlr_idle_notifier_v1_create(struct wl_display *disp
 
 	wl_list_init(&notifier->notifications);
 
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	notifier->timer = wl_event_loop_add_timer(loop, notifier_handle_timer, notifier);
+	if (notifier->timer == NULL) {
+		wl_global_destroy(notifier->global);
+		free(notifier);
+		return NULL;
+	}
+
 	notifier->display_destroy.notify = handle_display_destroy;
 	wl_display_add_destroy_listener(display, &notifier->display_destroy);
 
@@ -225,10 +272,12 @@ void wlr_idle_notifier_v1_set_inhibited(struct wlr_idle_notifier_v1 *notifier,
 
 	notifier->inhibited = inhibited;
 
+	int64_t now = get_current_time_msec();
 	struct wlr_idle_notification_v1 *notification;
 	wl_list_for_each(notification, &notifier->notifications, link) {
-		notification_reset_timer(notification);
+		notification_reset(notification, now);
 	}
+	notifier_update_timer(notifier, now);
 }
 
 void wlr_idle_notifier_v1_notify_activity(struct wlr_idle_notifier_v1 *notifier,
@@ -237,10 +286,20 @@ void wlr_idle_notifier_v1_notify_activity(struct wlr_idle_notifier_v1 *notifier,
 		return;
 	}
 
+	// Only record the time here, deadlines are checked when the timer fires.
+	// Activity pushes pending deadlines back, so the armed timer stays valid
+	// unless a notification resumed from idle.
+	int64_t now = get_current_time_msec();
+	bool update_timer = !notifier->timer_armed;
 	struct wlr_idle_notification_v1 *notification;
 	wl_list_for_each(notification, &notifier->notifications, link) {
-		if (notification->seat == seat) {
-			notification_handle_activity(notification);
+		if (notification->seat == seat &&
+				notification_handle_activity(notification, now)) {
+			update_timer = true;
 		}
 	}
+
+	if (update_timer) {
+		notifier_update_timer(notifier, now);
+	}
 }
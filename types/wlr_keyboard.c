@@ -13,6 +13,94 @@
 #include "util/shm.h"
 #include "util/time.h"
 
+/**
+ * A serialized keymap, shared by all keyboards using the same xkb_keymap.
+ */
+struct wlr_keyboard_keymap_file {
+	struct wl_list link; // keymap_files
+	struct xkb_keymap *keymap;
+	char *string;
+	size_t size;
+	int fd; // read-only
+	size_t n_refs;
+};
+
+static struct wl_list keymap_files = { &keymap_files, &keymap_files };
+
+static struct wlr_keyboard_keymap_file *keymap_file_create(
+		struct xkb_keymap *keymap) {
+	struct wlr_keyboard_keymap_file *file = calloc(1, sizeof(*file));
+	if (file == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	file->string = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
+	if (file->string == NULL) {
+		wlr_log(WLR_ERROR, "Failed to get string version of keymap");
+		goto error_file;
+	}
+	file->size = strlen(file->string) + 1;
+
+	int rw_fd = -1, ro_fd = -1;
+	if (!allocate_shm_file_pair(file->size, &rw_fd, &ro_fd)) {
+		wlr_log(WLR_ERROR, "Failed to allocate shm file for keymap");
+		goto error_string;
+	}
+
+	void *dst = mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_SHARED, rw_fd, 0);
+	close(rw_fd);
+	if (dst == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "mmap failed");
+		close(ro_fd);
+		goto error_string;
+	}
+
+	memcpy(dst, file->string, file->size);
+	munmap(dst, file->size);
+
+	file->keymap = xkb_keymap_ref(keymap);
+	file->fd = ro_fd;
+	file->n_refs = 1;
+	wl_list_insert(&keymap_files, &file->link);
+	return file;
+
+error_string:
+	free(file->string);
+error_file:
+	free(file);
+	return NULL;
+}
+
+static struct wlr_keyboard_keymap_file *keymap_file_acquire(
+		struct xkb_keymap *keymap) {
+	struct wlr_keyboard_keymap_file *file;
+	wl_list_for_each(file, &keymap_files, link) {
+		if (file->keymap == keymap) {
+			file->n_refs++;
+			return file;
+		}
+	}
+	return keymap_file_create(keymap);
+}
+
+static void keymap_file_release(struct wlr_keyboard_keymap_file *file) {
+	if (file == NULL) {
+		return;
+	}
+	assert(file->n_refs > 0);
+	file->n_refs--;
+	if (file->n_refs > 0) {
+		return;
+	}
+
+	wl_list_remove(&file->link);
+	xkb_keymap_unref(file->keymap);
+	free(file->string);
+	close(file->fd);
+	free(file);
+}
+
 struct wlr_keyboard *wlr_keyboard_from_input_device(
 		struct wlr_input_device *input_device) {
 	assert(input_device->type == WLR_INPUT_DEVICE_KEYBOARD);
@@ -147,12 +235,10 @@ static void keyboard_unset_keymap(struct wlr_keyboard *kb) {
 	kb->keymap = NULL;
 	xkb_state_unref(kb->xkb_state);
 	kb->xkb_state = NULL;
-	free(kb->keymap_string);
+	keymap_file_release(kb->keymap_file);
+	kb->keymap_file = NULL;
 	kb->keymap_string = NULL;
 	kb->keymap_size = 0;
-	if (kb->keymap_fd >= 0) {
-		close(kb->keymap_fd);
-	}
 	kb->keymap_fd = -1;
 }
 
@@ -204,36 +290,19 @@ bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb, struct xkb_keymap *keymap)
 		return false;
 	}
 
-	char *keymap_str = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
-	if (keymap_str == NULL) {
-		wlr_log(WLR_ERROR, "Failed to get string version of keymap");
-		goto error_xkb_state;
-	}
-	size_t keymap_size = strlen(keymap_str) + 1;
-
-	int rw_fd = -1, ro_fd = -1;
-	if (!allocate_shm_file_pair(keymap_size, &rw_fd, &ro_fd)) {
-		wlr_log(WLR_ERROR, "Failed to allocate shm file for keymap");
-		goto error_keymap_str;
-	}
-
-	void *dst = mmap(NULL, keymap_size, PROT_READ | PROT_WRITE, MAP_SHARED, rw_fd, 0);
-	close(rw_fd);
-	if (dst == MAP_FAILED) {
-		wlr_log_errno(WLR_ERROR, "mmap failed");
-		close(ro_fd);
-		goto error_keymap_str;
+	struct wlr_keyboard_keymap_file *keymap_file = keymap_file_acquire(keymap);
+	if (keymap_file == NULL) {
+		xkb_state_unref(xkb_state);
+		return false;
 	}
 
-	memcpy(dst, keymap_str, keymap_size);
-	munmap(dst, keymap_size);
-
 	keyboard_unset_keymap(kb);
 	kb->keymap = xkb_keymap_ref(keymap);
 	kb->xkb_state = xkb_state;
-	kb->keymap_string = keymap_str;
-	kb->keymap_size = keymap_size;
-	kb->keymap_fd = ro_fd;
+	kb->keymap_file = keymap_file;
+	kb->keymap_string = keymap_file->string;
+	kb->keymap_size = keymap_file->size;
+	kb->keymap_fd = keymap_file->fd;
 
 	const char *led_names[WLR_LED_COUNT] = {
 		XKB_LED_NAME_NUM,
@@ -269,12 +338,6 @@ bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb, struct xkb_keymap *keymap)
 	wl_signal_emit_mutable(&kb->events.keymap, kb);
 
 	return true;
-
-error_keymap_str:
-	free(keymap_str);
-error_xkb_state:
-	xkb_state_unref(xkb_state);
-	return false;
 }
 
 void wlr_keyboard_set_repeat_info(struct wlr_keyboard *kb, int32_t rate,
@@ -301,7 +364,7 @@ uint32_t wlr_keyboard_get_modifiers(struct wlr_keyboard *kb) {
 
 bool wlr_keyboard_keymaps_match(struct xkb_keymap *km1,
 		struct xkb_keymap *km2) {
-	if (!km1 && !km2) {
+	if (km1 == km2) {
 		return true;
 	}
 	if (!km1 || !km2) {
@@ -2,6 +2,7 @@
 #include <drm_fourcc.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
 #include <wlr/backend.h>
@@ -15,6 +16,7 @@
 #include <xf86drm.h>
 #include "linux-dmabuf-v1-protocol.h"
 #include "render/drm_format_set.h"
+#include "util/hash.h"
 #include "util/shm.h"
 
 #if WLR_HAS_DRM_BACKEND
@@ -37,6 +39,13 @@ struct wlr_linux_dmabuf_feedback_v1_compiled_tranche {
 };
 
 struct wlr_linux_dmabuf_feedback_v1_compiled {
+	struct wl_list link; // wlr_linux_dmabuf_v1.compiled_feedbacks
+	int ref_count;
+
+	// Serialized source feedback, used to share identical compiled feedback
+	struct wl_array key;
+	uint64_t key_hash;
+
 	dev_t main_device;
 	int table_fd;
 	size_t table_size;
@@ -625,11 +634,45 @@ err_all_formats:
 	return NULL;
 }
 
+static bool key_append(struct wl_array *key, const void *data, size_t size) {
+	void *p = wl_array_add(key, size);
+	if (p == NULL) {
+		return false;
+	}
+	memcpy(p, data, size);
+	return true;
+}
+
+static bool feedback_get_key(const struct wlr_linux_dmabuf_feedback_v1 *feedback,
+		struct wl_array *key) {
+	const struct wlr_linux_dmabuf_feedback_v1_tranche *tranches = feedback->tranches.data;
+	size_t tranches_len = feedback->tranches.size / sizeof(struct wlr_linux_dmabuf_feedback_v1_tranche);
+
+	if (!key_append(key, &feedback->main_device, sizeof(feedback->main_device)) ||
+			!key_append(key, &tranches_len, sizeof(tranches_len))) {
+		return false;
+	}
+	for (size_t i = 0; i < tranches_len; i++) {
+		const struct wlr_linux_dmabuf_feedback_v1_tranche *tranche = &tranches[i];
+		if (!key_append(key, &tranche->target_device, sizeof(tranche->target_device)) ||
+				!key_append(key, &tranche->flags, sizeof(tranche->flags)) ||
+				!key_append(key, &tranche->formats.len, sizeof(tranche->formats.len))) {
+			return false;
+		}
+		for (size_t j = 0; j < tranche->formats.len; j++) {
+			const struct wlr_drm_format *fmt = &tranche->formats.formats[j];
+			if (!key_append(key, &fmt->format, sizeof(fmt->format)) ||
+					!key_append(key, &fmt->len, sizeof(fmt->len)) ||
+					!key_append(key, fmt->modifiers, fmt->len * sizeof(fmt->modifiers[0]))) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
 static void compiled_feedback_destroy(
 		struct wlr_linux_dmabuf_feedback_v1_compiled *feedback) {
-	if (feedback == NULL) {
-		return;
-	}
 	for (size_t i = 0; i < feedback->tranches_len; i++) {
 		wl_array_release(&feedback->tranches[i].indices);
 	}
@@ -637,6 +680,60 @@ static void compiled_feedback_destroy(
 	free(feedback);
 }
 
+/**
+ * Get a compiled version of the feedback. Identical feedback shares the same
+ * compiled object, and thus the same format table.
+ */
+static struct wlr_linux_dmabuf_feedback_v1_compiled *compiled_feedback_get(
+		struct wlr_linux_dmabuf_v1 *linux_dmabuf,
+		const struct wlr_linux_dmabuf_feedback_v1 *feedback) {
+	struct wl_array key;
+	wl_array_init(&key);
+	if (!feedback_get_key(feedback, &key)) {
+		wlr_log(WLR_ERROR, "Failed to allocate feedback key");
+		wl_array_release(&key);
+		return NULL;
+	}
+	uint64_t key_hash = hash_fnv1a(HASH_FNV1A_INIT, key.data, key.size);
+
+	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled;
+	wl_list_for_each(compiled, &linux_dmabuf->compiled_feedbacks, link) {
+		if (compiled->key_hash == key_hash && compiled->key.size == key.size &&
+				memcmp(compiled->key.data, key.data, key.size) == 0) {
+			wl_array_release(&key);
+			compiled->ref_count++;
+			return compiled;
+		}
+	}
+
+	compiled = feedback_compile(feedback);
+	if (compiled == NULL) {
+		wl_array_release(&key);
+		return NULL;
+	}
+
+	compiled->key = key;
+	compiled->key_hash = key_hash;
+	compiled->ref_count = 1;
+	wl_list_insert(&linux_dmabuf->compiled_feedbacks, &compiled->link);
+	return compiled;
+}
+
+static void compiled_feedback_unref(
+		struct wlr_linux_dmabuf_feedback_v1_compiled *compiled) {
+	if (compiled == NULL) {
+		return;
+	}
+	assert(compiled->ref_count > 0);
+	compiled->ref_count--;
+	if (compiled->ref_count > 0) {
+		return;
+	}
+	wl_list_remove(&compiled->link);
+	wl_array_release(&compiled->key);
+	compiled_feedback_destroy(compiled);
+}
+
 static void feedback_tranche_send(
 		const struct wlr_linux_dmabuf_feedback_v1_compiled_tranche *tranche,
 		struct wl_resource *resource) {
@@ -695,7 +792,7 @@ static void surface_destroy(struct wlr_linux_dmabuf_v1_surface *surface) {
 		wl_list_init(link);
 	}
 
-	compiled_feedback_destroy(surface->feedback);
+	compiled_feedback_unref(surface->feedback);
 
 	wlr_addon_finish(&surface->addon);
 	wl_list_remove(&surface->link);
@@ -866,7 +963,8 @@ static void linux_dmabuf_v1_destroy(struct wlr_linux_dmabuf_v1 *linux_dmabuf) {
 		surface_destroy(surface);
 	}
 
-	compiled_feedback_destroy(linux_dmabuf->default_feedback);
+	compiled_feedback_unref(linux_dmabuf->default_feedback);
+	assert(wl_list_empty(&linux_dmabuf->compiled_feedbacks));
 	wlr_drm_format_set_finish(&linux_dmabuf->default_formats);
 	if (linux_dmabuf->main_device_fd >= 0) {
 		close(linux_dmabuf->main_device_fd);
@@ -886,7 +984,8 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 
 static bool set_default_feedback(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
 		const struct wlr_linux_dmabuf_feedback_v1 *feedback) {
-	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled = feedback_compile(feedback);
+	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled =
+		compiled_feedback_get(linux_dmabuf, feedback);
 	if (compiled == NULL) {
 		return false;
 	}
@@ -928,7 +1027,7 @@ static bool set_default_feedback(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
 		}
 	}
 
-	compiled_feedback_destroy(linux_dmabuf->default_feedback);
+	compiled_feedback_unref(linux_dmabuf->default_feedback);
 	linux_dmabuf->default_feedback = compiled;
 
 	if (linux_dmabuf->main_device_fd >= 0) {
@@ -944,7 +1043,7 @@ static bool set_default_feedback(struct wlr_linux_dmabuf_v1 *linux_dmabuf,
 error_formats:
 	wlr_drm_format_set_finish(&formats);
 error_compiled:
-	compiled_feedback_destroy(compiled);
+	compiled_feedback_unref(compiled);
 	return false;
 }
 
@@ -960,6 +1059,7 @@ struct wlr_linux_dmabuf_v1 *wlr_linux_dmabuf_v1_create(struct wl_display *displa
 	linux_dmabuf->main_device_fd = -1;
 
 	wl_list_init(&linux_dmabuf->surfaces);
+	wl_list_init(&linux_dmabuf->compiled_feedbacks);
 
 	wl_signal_init(&linux_dmabuf->events.destroy);
 
@@ -1025,15 +1125,24 @@ bool wlr_linux_dmabuf_v1_set_surface_feedback(
 
 	struct wlr_linux_dmabuf_feedback_v1_compiled *compiled = NULL;
 	if (feedback != NULL) {
-		compiled = feedback_compile(feedback);
+		compiled = compiled_feedback_get(linux_dmabuf, feedback);
 		if (compiled == NULL) {
 			return false;
 		}
 	}
 
-	compiled_feedback_destroy(surface->feedback);
+	// Identical feedback resolves to the same compiled object, clients
+	// already have it
+	bool changed = surface_get_feedback(surface) !=
+		(compiled != NULL ? compiled : linux_dmabuf->default_feedback);
+
+	compiled_feedback_unref(surface->feedback);
 	surface->feedback = compiled;
 
+	if (!changed) {
+		return true;
+	}
+
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &surface->feedback_resources) {
 		feedback_send(surface_get_feedback(surface), resource);
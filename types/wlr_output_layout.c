@@ -39,6 +39,10 @@ static void output_layout_output_destroy(
 
 	assert(wl_list_empty(&l_output->events.destroy.listener_list));
 
+	if (l_output->layout->last_hit == l_output) {
+		l_output->layout->last_hit = NULL;
+	}
+
 	wlr_output_destroy_global(l_output->output);
 	wl_list_remove(&l_output->commit.link);
 	wl_list_remove(&l_output->link);
@@ -69,10 +73,7 @@ void wlr_output_layout_destroy(struct wlr_output_layout *layout) {
 static void output_layout_output_get_box(
 		struct wlr_output_layout_output *l_output,
 		struct wlr_box *box) {
-	box->x = l_output->x;
-	box->y = l_output->y;
-	wlr_output_effective_resolution(l_output->output,
-		&box->width, &box->height);
+	*box = l_output->box;
 }
 
 /**
@@ -86,9 +87,17 @@ static void output_layout_reconfigure(struct wlr_output_layout *layout) {
 	int max_x = INT_MIN;
 	int max_x_y = INT_MIN; // y value for the max_x output
 
+	// refresh the cached boxes, output sizes may have changed
+	struct wlr_output_layout_output *l_output;
+	wl_list_for_each(l_output, &layout->outputs, link) {
+		l_output->box.x = l_output->x;
+		l_output->box.y = l_output->y;
+		wlr_output_effective_resolution(l_output->output,
+			&l_output->box.width, &l_output->box.height);
+	}
+
 	// find the rightmost x coordinate occupied by a manually configured output
 	// in the layout
-	struct wlr_output_layout_output *l_output;
 	struct wlr_box output_box;
 
 	wl_list_for_each(l_output, &layout->outputs, link) {
@@ -116,9 +125,28 @@ static void output_layout_reconfigure(struct wlr_output_layout *layout) {
 		output_layout_output_get_box(l_output, &output_box);
 		l_output->x = max_x;
 		l_output->y = max_x_y;
+		l_output->box.x = l_output->x;
+		l_output->box.y = l_output->y;
 		max_x += output_box.width;
 	}
 
+	// point lookups can only use the last hit if no other output may take
+	// precedence over it
+	layout->last_hit = NULL;
+	layout->overlapping = false;
+	wl_list_for_each(l_output, &layout->outputs, link) {
+		struct wlr_output_layout_output *other;
+		wl_list_for_each(other, &layout->outputs, link) {
+			if (other == l_output) {
+				break;
+			}
+			struct wlr_box intersection;
+			if (wlr_box_intersection(&intersection, &l_output->box, &other->box)) {
+				layout->overlapping = true;
+			}
+		}
+	}
+
 	wl_signal_emit_mutable(&layout->events.change, layout);
 }
 
@@ -285,19 +313,31 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 	}
 }
 
-struct wlr_output *wlr_output_layout_output_at(struct wlr_output_layout *layout,
-		double lx, double ly) {
-	struct wlr_output_layout_output *l_output;
+static struct wlr_output_layout_output *output_layout_output_at(
+		struct wlr_output_layout *layout, double lx, double ly) {
+	// The cursor usually stays on the same output
+	struct wlr_output_layout_output *l_output = layout->last_hit;
+	if (l_output != NULL && !layout->overlapping &&
+			wlr_box_contains_point(&l_output->box, lx, ly)) {
+		return l_output;
+	}
+
 	wl_list_for_each(l_output, &layout->outputs, link) {
-		struct wlr_box output_box;
-		output_layout_output_get_box(l_output, &output_box);
-		if (wlr_box_contains_point(&output_box, lx, ly)) {
-			return l_output->output;
+		if (wlr_box_contains_point(&l_output->box, lx, ly)) {
+			layout->last_hit = l_output;
+			return l_output;
 		}
 	}
 	return NULL;
 }
 
+struct wlr_output *wlr_output_layout_output_at(struct wlr_output_layout *layout,
+		double lx, double ly) {
+	struct wlr_output_layout_output *l_output =
+		output_layout_output_at(layout, lx, ly);
+	return l_output != NULL ? l_output->output : NULL;
+}
+
 void wlr_output_layout_output_coords(struct wlr_output_layout *layout,
 		struct wlr_output *reference, double *lx, double *ly) {
 	assert(layout && reference);
@@ -323,6 +363,18 @@ void wlr_output_layout_closest_point(struct wlr_output_layout *layout,
 
 	double min_x = lx, min_y = ly, min_distance = DBL_MAX;
 	struct wlr_output_layout_output *l_output;
+
+	// A point inside an output is its own closest point
+	l_output = reference != NULL ? wlr_output_layout_get(layout, reference) :
+		output_layout_output_at(layout, lx, ly);
+	if (l_output != NULL) {
+		double output_x, output_y;
+		wlr_box_closest_point(&l_output->box, lx, ly, &output_x, &output_y);
+		if (output_x == lx && output_y == ly) {
+			goto out;
+		}
+	}
+
 	wl_list_for_each(l_output, &layout->outputs, link) {
 		if (reference != NULL && reference != l_output->output) {
 			continue;
@@ -348,6 +400,7 @@ void wlr_output_layout_closest_point(struct wlr_output_layout *layout,
 		}
 	}
 
+out:
 	if (dest_lx) {
 		*dest_lx = min_x;
 	}
@@ -1,11 +1,13 @@
 #undef _POSIX_C_SOURCE
-#define _DEFAULT_SOURCE // for MAP_ANONYMOUS
+#define _GNU_SOURCE // for MAP_ANONYMOUS and F_GET_SEALS
 #include <assert.h>
 #include <drm_fourcc.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <stdatomic.h>
 #include <stdlib.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wayland-server-protocol.h>
 #include <wlr/interfaces/wlr_buffer.h>
@@ -30,6 +32,9 @@ struct wlr_shm_pool {
 	struct wl_list buffers; // wlr_shm_buffer.link
 	int fd;
 	struct wlr_shm_mapping *mapping;
+	// The client can't shrink the backing file, so accessing the mapping
+	// can't trigger SIGBUS
+	bool sealed;
 };
 
 /**
@@ -44,12 +49,13 @@ struct wlr_shm_mapping {
 	void *data;
 	size_t size;
 	bool dropped; // false while a wlr_shm_pool references this mapping
+	size_t access_count; // number of in-flight data pointer accesses
 };
 
 struct wlr_shm_sigbus_data {
 	struct wlr_shm_mapping *mapping;
-	struct sigaction prev_action;
 	struct wlr_shm_sigbus_data *_Atomic next;
+	struct wlr_shm_sigbus_data *prev; // not accessed from the signal handler
 };
 
 struct wlr_shm_buffer {
@@ -64,11 +70,16 @@ struct wlr_shm_buffer {
 	struct wl_listener release;
 
 	struct wlr_shm_sigbus_data sigbus_data;
+	bool sigbus_registered;
 };
 
 // Needs to be a lock-free atomic because it's accessed from a signal handler
 static struct wlr_shm_sigbus_data *_Atomic sigbus_data = NULL;
 
+// The SIGBUS handler is installed once for as long as a wlr_shm exists
+static size_t sigbus_handler_users = 0;
+static struct sigaction sigbus_prev_action;
+
 static const struct wl_buffer_interface wl_buffer_impl;
 static const struct wl_shm_pool_interface pool_impl;
 static const struct wl_shm_interface shm_impl;
@@ -117,16 +128,10 @@ static struct wlr_shm_mapping *mapping_create(int fd, size_t size) {
 }
 
 static void mapping_consider_destroy(struct wlr_shm_mapping *mapping) {
-	if (!mapping->dropped) {
+	if (!mapping->dropped || mapping->access_count > 0) {
 		return;
 	}
 
-	for (struct wlr_shm_sigbus_data *cur = sigbus_data; cur != NULL; cur = cur->next) {
-		if (cur->mapping == mapping) {
-			return;
-		}
-	}
-
 	munmap(mapping->data, mapping->size);
 	free(mapping);
 }
@@ -180,8 +185,7 @@ static bool buffer_get_shm(struct wlr_buffer *wlr_buffer,
 }
 
 static void handle_sigbus(int sig, siginfo_t *info, void *context) {
-	assert(sigbus_data != NULL);
-	struct sigaction prev_action = sigbus_data->prev_action;
+	struct sigaction prev_action = sigbus_prev_action;
 
 	// Check whether the offending address is inside of the wl_shm_pool's mapped
 	// space
@@ -212,14 +216,19 @@ static void handle_sigbus(int sig, siginfo_t *info, void *context) {
 reraise:
 	if (prev_action.sa_flags & SA_SIGINFO) {
 		prev_action.sa_sigaction(sig, info, context);
-	} else {
+	} else if (prev_action.sa_handler == SIG_DFL) {
+		// Restore the default action and let the fault happen again
+		sigaction(SIGBUS, &prev_action, NULL);
+	} else if (prev_action.sa_handler != SIG_IGN) {
 		prev_action.sa_handler(sig);
 	}
 }
 
-static bool buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
-		uint32_t flags, void **data, uint32_t *format, size_t *stride) {
-	struct wlr_shm_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+static bool sigbus_handler_acquire(void) {
+	if (sigbus_handler_users > 0) {
+		sigbus_handler_users++;
+		return true;
+	}
 
 	if (!atomic_is_lock_free(&sigbus_data)) {
 		wlr_log(WLR_ERROR, "Lock-free atomic pointers are required");
@@ -228,28 +237,74 @@ static bool buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
 
 	// Install a SIGBUS handler. SIGBUS is triggered if the client shrinks the
 	// backing file, and then we try to access the mapping.
-	struct sigaction prev_action;
-	if (sigbus_data == NULL) {
-		struct sigaction new_action = {
-			.sa_sigaction = handle_sigbus,
-			.sa_flags = SA_SIGINFO | SA_NODEFER,
-		};
-		if (sigaction(SIGBUS, &new_action, &prev_action) != 0) {
-			wlr_log_errno(WLR_ERROR, "sigaction failed");
-			return false;
-		}
-	} else {
-		prev_action = sigbus_data->prev_action;
+	struct sigaction new_action = {
+		.sa_sigaction = handle_sigbus,
+		.sa_flags = SA_SIGINFO | SA_NODEFER,
+	};
+	if (sigaction(SIGBUS, &new_action, &sigbus_prev_action) != 0) {
+		wlr_log_errno(WLR_ERROR, "sigaction failed");
+		return false;
+	}
+
+	sigbus_handler_users++;
+	return true;
+}
+
+static void sigbus_handler_release(void) {
+	assert(sigbus_handler_users > 0);
+	sigbus_handler_users--;
+	if (sigbus_handler_users > 0) {
+		return;
+	}
+
+	assert(sigbus_data == NULL);
+	if (sigaction(SIGBUS, &sigbus_prev_action, NULL) != 0) {
+		wlr_log_errno(WLR_ERROR, "sigaction failed");
+	}
+}
+
+/**
+ * Check whether the client can no longer truncate the file backing a mapping
+ * of the given size, i.e. whether accessing the mapping can't raise SIGBUS.
+ */
+static bool fd_is_shrink_sealed(int fd, size_t size) {
+#ifdef F_GET_SEALS
+	int seals = fcntl(fd, F_GET_SEALS);
+	if (seals < 0 || !(seals & F_SEAL_SHRINK)) {
+		return false;
 	}
 
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		return false;
+	}
+	return st.st_size >= 0 && (size_t)st.st_size >= size;
+#else
+	return false;
+#endif
+}
+
+static bool buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
+		uint32_t flags, void **data, uint32_t *format, size_t *stride) {
+	struct wlr_shm_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
 	struct wlr_shm_mapping *mapping = buffer->pool->mapping;
 
 	buffer->sigbus_data = (struct wlr_shm_sigbus_data){
 		.mapping = mapping,
-		.prev_action = prev_action,
-		.next = sigbus_data,
 	};
-	sigbus_data = &buffer->sigbus_data;
+	mapping->access_count++;
+
+	// Sealed pools can't be shrunk by the client, no need to guard against
+	// SIGBUS
+	buffer->sigbus_registered = !buffer->pool->sealed;
+	if (buffer->sigbus_registered) {
+		struct wlr_shm_sigbus_data *head = sigbus_data;
+		buffer->sigbus_data.next = head;
+		if (head != NULL) {
+			head->prev = &buffer->sigbus_data;
+		}
+		sigbus_data = &buffer->sigbus_data;
+	}
 
 	*data = (char *)mapping->data + buffer->offset;
 	*format = buffer->drm_format;
@@ -259,25 +314,26 @@ static bool buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
 
 static void buffer_end_data_ptr_access(struct wlr_buffer *wlr_buffer) {
 	struct wlr_shm_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+	struct wlr_shm_sigbus_data *data = &buffer->sigbus_data;
 
-	if (sigbus_data == &buffer->sigbus_data) {
-		sigbus_data = buffer->sigbus_data.next;
-	} else {
-		for (struct wlr_shm_sigbus_data *cur = sigbus_data; cur != NULL; cur = cur->next) {
-			if (cur->next == &buffer->sigbus_data) {
-				cur->next = buffer->sigbus_data.next;
-				break;
-			}
+	if (buffer->sigbus_registered) {
+		struct wlr_shm_sigbus_data *next = data->next;
+		if (next != NULL) {
+			next->prev = data->prev;
 		}
-	}
-
-	if (sigbus_data == NULL) {
-		if (sigaction(SIGBUS, &buffer->sigbus_data.prev_action, NULL) != 0) {
-			wlr_log_errno(WLR_ERROR, "sigaction failed");
+		if (data->prev != NULL) {
+			data->prev->next = next;
+		} else {
+			assert(sigbus_data == data);
+			sigbus_data = next;
 		}
+		buffer->sigbus_registered = false;
 	}
 
-	mapping_consider_destroy(buffer->sigbus_data.mapping);
+	struct wlr_shm_mapping *mapping = data->mapping;
+	assert(mapping->access_count > 0);
+	mapping->access_count--;
+	mapping_consider_destroy(mapping);
 }
 
 static const struct wlr_buffer_impl buffer_impl = {
@@ -392,6 +448,7 @@ static void pool_handle_resize(struct wl_client *client,
 
 	mapping_drop(pool->mapping);
 	pool->mapping = mapping;
+	pool->sealed = fd_is_shrink_sealed(pool->fd, mapping->size);
 }
 
 static const struct wl_shm_pool_interface pool_impl = {
@@ -452,6 +509,7 @@ static void shm_handle_create_pool(struct wl_client *client,
 	pool->mapping = mapping;
 	pool->shm = shm;
 	pool->fd = fd;
+	pool->sealed = fd_is_shrink_sealed(fd, size);
 	wl_list_init(&pool->buffers);
 	return;
 
@@ -494,6 +552,7 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_shm *shm = wl_container_of(listener, shm, display_destroy);
 	wl_list_remove(&shm->display_destroy.link);
 	wl_global_destroy(shm->global);
+	sigbus_handler_release();
 	free(shm->formats);
 	free(shm);
 }
@@ -533,10 +592,17 @@ struct wlr_shm *wlr_shm_create(struct wl_display *display, uint32_t version,
 		shm->formats[i] = convert_drm_format_to_wl_shm(formats[i]);
 	}
 
+	if (!sigbus_handler_acquire()) {
+		free(shm->formats);
+		free(shm);
+		return NULL;
+	}
+
 	shm->global = wl_global_create(display, &wl_shm_interface, version,
 		shm, shm_bind);
 	if (shm->global == NULL) {
 		wlr_log(WLR_ERROR, "wl_global_create failed");
+		sigbus_handler_release();
 		free(shm->formats);
 		free(shm);
 		return NULL;
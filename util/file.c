@@ -0,0 +1,74 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "util/file.h"
+
+static bool make_parent_dirs(const char *path) {
+	char dir[PATH_MAX];
+	int n = snprintf(dir, sizeof(dir), "%s", path);
+	if (n < 0 || (size_t)n >= sizeof(dir)) {
+		errno = ENAMETOOLONG;
+		return false;
+	}
+	char *end = strrchr(dir, '/');
+	if (end == NULL || end == dir) {
+		return true;
+	}
+	*end = '\0';
+
+	for (char *c = dir + 1; *c != '\0'; c++) {
+		if (*c != '/') {
+			continue;
+		}
+		*c = '\0';
+		int ret = mkdir(dir, 0700);
+		*c = '/';
+		if (ret != 0 && errno != EEXIST) {
+			return false;
+		}
+	}
+	return mkdir(dir, 0700) == 0 || errno == EEXIST;
+}
+
+bool write_file_atomic(const char *path, const struct iovec *iov, size_t iov_len) {
+	if (!make_parent_dirs(path)) {
+		return false;
+	}
+
+	char tmp_path[PATH_MAX];
+	int n = snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+	if (n < 0 || (size_t)n >= sizeof(tmp_path)) {
+		errno = ENAMETOOLONG;
+		return false;
+	}
+	int fd = mkstemp(tmp_path);
+	if (fd < 0) {
+		return false;
+	}
+
+	FILE *f = fdopen(fd, "w");
+	if (f == NULL) {
+		int err = errno;
+		close(fd);
+		unlink(tmp_path);
+		errno = err;
+		return false;
+	}
+
+	bool ok = true;
+	for (size_t i = 0; ok && i < iov_len; i++) {
+		ok = fwrite(iov[i].iov_base, 1, iov[i].iov_len, f) == iov[i].iov_len;
+	}
+	ok = fclose(f) == 0 && ok;
+	if (!ok || rename(tmp_path, path) != 0) {
+		int err = errno;
+		unlink(tmp_path);
+		errno = err;
+		return false;
+	}
+	return true;
+}
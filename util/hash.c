@@ -0,0 +1,10 @@
+#include "util/hash.h"
+
+uint64_t hash_fnv1a(uint64_t hash, const void *data, size_t size) {
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= UINT64_C(0x100000001b3);
+	}
+	return hash;
+}
@@ -1,5 +1,9 @@
 #include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,6 +16,7 @@
 static bool colored = true;
 static enum wlr_log_importance log_importance = WLR_ERROR;
 static struct timespec start_time = {-1};
+static int stderr_is_tty = -1;
 
 static const char *verbosity_colors[] = {
 	[WLR_SILENT] = "",
@@ -34,6 +39,16 @@ static void init_start_time(void) {
 	clock_gettime(CLOCK_MONOTONIC, &start_time);
 }
 
+static bool use_colors(void) {
+	if (!colored) {
+		return false;
+	}
+	if (stderr_is_tty < 0) {
+		stderr_is_tty = isatty(STDERR_FILENO);
+	}
+	return stderr_is_tty;
+}
+
 static void log_stderr(enum wlr_log_importance verbosity, const char *fmt,
 		va_list args) {
 	init_start_time();
@@ -52,7 +67,8 @@ static void log_stderr(enum wlr_log_importance verbosity, const char *fmt,
 
 	unsigned c = (verbosity < WLR_LOG_IMPORTANCE_LAST) ? verbosity : WLR_LOG_IMPORTANCE_LAST - 1;
 
-	if (colored && isatty(STDERR_FILENO)) {
+	bool colors = use_colors();
+	if (colors) {
 		fprintf(stderr, "%s", verbosity_colors[c]);
 	} else {
 		fprintf(stderr, "%s ", verbosity_headers[c]);
@@ -60,12 +76,243 @@ static void log_stderr(enum wlr_log_importance verbosity, const char *fmt,
 
 	vfprintf(stderr, fmt, args);
 
-	if (colored && isatty(STDERR_FILENO)) {
+	if (colors) {
 		fprintf(stderr, "\x1B[0m");
 	}
 	fprintf(stderr, "\n");
 }
 
+#define ASYNC_LOG_CAPACITY 256
+#define ASYNC_LOG_MSG_SIZE 1024
+
+struct async_log_entry {
+	enum wlr_log_importance verbosity;
+	struct timespec ts;
+	char msg[ASYNC_LOG_MSG_SIZE];
+};
+
+/**
+ * Ring buffer drained by the writer thread. head and tail are sequence
+ * numbers: entries in [tail, head) are pending. Producers only touch free
+ * slots and the writer only touches pending slots, so entries are accessed
+ * without holding the lock.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t pending; // signalled when entries are queued
+	pthread_cond_t written; // broadcast when entries are written
+	pthread_t thread;
+	bool running;
+	bool stopping;
+
+	struct async_log_entry *entries;
+	uint64_t head, tail;
+	uint64_t dropped;
+} async_log = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.pending = PTHREAD_COND_INITIALIZER,
+	.written = PTHREAD_COND_INITIALIZER,
+};
+
+static void write_all(const char *buf, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(STDERR_FILENO, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+static void async_log_write_entry(const struct async_log_entry *entry) {
+	struct timespec ts;
+	timespec_sub(&ts, &entry->ts, &start_time);
+
+	unsigned c = (entry->verbosity < WLR_LOG_IMPORTANCE_LAST) ?
+		entry->verbosity : WLR_LOG_IMPORTANCE_LAST - 1;
+	bool colors = use_colors();
+
+	char line[ASYNC_LOG_MSG_SIZE + 64];
+	int n = snprintf(line, sizeof(line), "%02d:%02d:%02d.%03ld %s%s%s%s\n",
+		(int)(ts.tv_sec / 60 / 60), (int)(ts.tv_sec / 60 % 60),
+		(int)(ts.tv_sec % 60), ts.tv_nsec / 1000000,
+		colors ? verbosity_colors[c] : verbosity_headers[c],
+		colors ? "" : " ", entry->msg, colors ? "\x1B[0m" : "");
+	if (n < 0) {
+		return;
+	}
+	if ((size_t)n >= sizeof(line)) {
+		n = sizeof(line) - 1;
+		line[n - 1] = '\n';
+	}
+	write_all(line, n);
+}
+
+static void async_log_write_dropped(uint64_t dropped) {
+	char line[128];
+	int n = snprintf(line, sizeof(line),
+		"[wlr_log] %"PRIu64" messages dropped: stderr is too slow\n", dropped);
+	if (n > 0) {
+		write_all(line, n);
+	}
+}
+
+static void *async_log_run(void *data) {
+	pthread_mutex_lock(&async_log.lock);
+	while (true) {
+		while (async_log.tail == async_log.head && async_log.dropped == 0 &&
+				!async_log.stopping) {
+			pthread_cond_wait(&async_log.pending, &async_log.lock);
+		}
+		if (async_log.tail == async_log.head && async_log.dropped == 0) {
+			break; // stopping and fully drained
+		}
+
+		uint64_t tail = async_log.tail, head = async_log.head;
+		uint64_t dropped = async_log.dropped;
+		async_log.dropped = 0;
+		pthread_mutex_unlock(&async_log.lock);
+
+		for (uint64_t seq = tail; seq < head; seq++) {
+			async_log_write_entry(&async_log.entries[seq % ASYNC_LOG_CAPACITY]);
+		}
+		if (dropped > 0) {
+			async_log_write_dropped(dropped);
+		}
+
+		pthread_mutex_lock(&async_log.lock);
+		async_log.tail = head;
+		pthread_cond_broadcast(&async_log.written);
+	}
+	pthread_mutex_unlock(&async_log.lock);
+	return NULL;
+}
+
+static void log_async(enum wlr_log_importance verbosity, const char *fmt,
+		va_list args) {
+	if (verbosity > log_importance) {
+		return;
+	}
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	pthread_mutex_lock(&async_log.lock);
+	if (!async_log.running) {
+		// The writer thread has been stopped at exit
+		pthread_mutex_unlock(&async_log.lock);
+		log_stderr(verbosity, fmt, args);
+		return;
+	}
+	// Errors often precede a crash: never drop them, and make sure they
+	// reach stderr before returning
+	bool sync = verbosity <= WLR_ERROR &&
+		!pthread_equal(pthread_self(), async_log.thread);
+	while (sync && async_log.head - async_log.tail >= ASYNC_LOG_CAPACITY) {
+		pthread_cond_wait(&async_log.written, &async_log.lock);
+	}
+	if (async_log.head - async_log.tail >= ASYNC_LOG_CAPACITY) {
+		async_log.dropped++;
+		pthread_mutex_unlock(&async_log.lock);
+		return;
+	}
+
+	uint64_t seq = async_log.head;
+	struct async_log_entry *entry =
+		&async_log.entries[seq % ASYNC_LOG_CAPACITY];
+	entry->verbosity = verbosity;
+	entry->ts = ts;
+	vsnprintf(entry->msg, sizeof(entry->msg), fmt, args);
+	async_log.head++;
+	pthread_cond_signal(&async_log.pending);
+
+	while (sync && async_log.tail <= seq) {
+		pthread_cond_wait(&async_log.written, &async_log.lock);
+	}
+	pthread_mutex_unlock(&async_log.lock);
+}
+
+static void async_log_stop(void) {
+	pthread_mutex_lock(&async_log.lock);
+	if (!async_log.running) {
+		pthread_mutex_unlock(&async_log.lock);
+		return;
+	}
+	async_log.stopping = true;
+	pthread_cond_signal(&async_log.pending);
+	pthread_mutex_unlock(&async_log.lock);
+
+	pthread_join(async_log.thread, NULL);
+
+	pthread_mutex_lock(&async_log.lock);
+	async_log.running = false;
+	pthread_mutex_unlock(&async_log.lock);
+}
+
+// Hold the lock across fork() so the child gets a consistent copy
+static void async_log_prepare_fork(void) {
+	pthread_mutex_lock(&async_log.lock);
+}
+
+static void async_log_parent_fork(void) {
+	pthread_mutex_unlock(&async_log.lock);
+}
+
+// The writer thread doesn't exist in the child: fall back to synchronous
+// logging there, queued entries belong to the parent
+static void async_log_child_fork(void) {
+	async_log.running = false;
+	async_log.stopping = false;
+	async_log.head = async_log.tail = 0;
+	async_log.dropped = 0;
+	pthread_cond_init(&async_log.pending, NULL);
+	pthread_cond_init(&async_log.written, NULL);
+	pthread_mutex_unlock(&async_log.lock);
+}
+
+static bool async_log_start(void) {
+	if (async_log.running) {
+		return true;
+	}
+
+	if (async_log.entries == NULL) {
+		async_log.entries = calloc(ASYNC_LOG_CAPACITY, sizeof(*async_log.entries));
+		if (async_log.entries == NULL) {
+			return false;
+		}
+	}
+
+	// Resolve this once, before the writer thread reads it
+	use_colors();
+
+	async_log.stopping = false;
+	async_log.running = true;
+
+	// Don't let the writer thread receive signals meant for the compositor
+	sigset_t mask, prev_mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_SETMASK, &mask, &prev_mask);
+	int ret = pthread_create(&async_log.thread, NULL, async_log_run, NULL);
+	pthread_sigmask(SIG_SETMASK, &prev_mask, NULL);
+	if (ret != 0) {
+		async_log.running = false;
+		return false;
+	}
+
+	static bool registered_handlers = false;
+	if (!registered_handlers) {
+		atexit(async_log_stop);
+		pthread_atfork(async_log_prepare_fork, async_log_parent_fork,
+			async_log_child_fork);
+		registered_handlers = true;
+	}
+	return true;
+}
+
 static wlr_log_func_t log_callback = log_stderr;
 
 static void log_wl(const char *fmt, va_list args) {
@@ -91,6 +338,16 @@ void wlr_log_init(enum wlr_log_importance verbosity, wlr_log_func_t callback) {
 	wl_log_set_handler_server(log_wl);
 }
 
+void wlr_log_init_async(enum wlr_log_importance verbosity) {
+	wlr_log_init(verbosity, NULL);
+
+	if (!async_log_start()) {
+		wlr_log(WLR_ERROR, "Failed to start log thread, logging synchronously");
+		return;
+	}
+	log_callback = log_async;
+}
+
 void _wlr_vlog(enum wlr_log_importance verbosity, const char *fmt, va_list args) {
 	log_callback(verbosity, fmt, args);
 }
@@ -1,9 +1,30 @@
 #include <assert.h>
 #include <math.h>
 #include <limits.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <wlr/util/region.h>
 
+// Most regions only have a handful of rectangles, avoid hitting the heap
+// for those
+#define STACK_RECTS_LEN 32
+
+static pixman_box32_t *alloc_rects(pixman_box32_t *stack_rects, int nrects) {
+	if (nrects <= STACK_RECTS_LEN) {
+		return stack_rects;
+	}
+	return malloc(nrects * sizeof(pixman_box32_t));
+}
+
+static void region_init_rects(pixman_region32_t *dst, pixman_box32_t *rects,
+		int nrects, pixman_box32_t *stack_rects) {
+	pixman_region32_fini(dst);
+	pixman_region32_init_rects(dst, rects, nrects);
+	if (rects != stack_rects) {
+		free(rects);
+	}
+}
+
 void wlr_region_scale(pixman_region32_t *dst, const pixman_region32_t *src,
 		float scale) {
 	wlr_region_scale_xy(dst, src, scale, scale);
@@ -19,21 +40,56 @@ void wlr_region_scale_xy(pixman_region32_t *dst, const pixman_region32_t *src,
 	int nrects;
 	const pixman_box32_t *src_rects = pixman_region32_rectangles(src, &nrects);
 
-	pixman_box32_t *dst_rects = malloc(nrects * sizeof(pixman_box32_t));
+	pixman_box32_t stack_rects[STACK_RECTS_LEN];
+	pixman_box32_t *dst_rects = alloc_rects(stack_rects, nrects);
 	if (dst_rects == NULL) {
 		return;
 	}
 
-	for (int i = 0; i < nrects; ++i) {
-		dst_rects[i].x1 = floor(src_rects[i].x1 * scale_x);
-		dst_rects[i].x2 = ceil(src_rects[i].x2 * scale_x);
-		dst_rects[i].y1 = floor(src_rects[i].y1 * scale_y);
-		dst_rects[i].y2 = ceil(src_rects[i].y2 * scale_y);
+	int int_scale_x = (int)scale_x, int_scale_y = (int)scale_y;
+	if (int_scale_x == scale_x && int_scale_y == scale_y) {
+		// Integer scales don't need rounding
+		for (int i = 0; i < nrects; ++i) {
+			dst_rects[i].x1 = src_rects[i].x1 * int_scale_x;
+			dst_rects[i].x2 = src_rects[i].x2 * int_scale_x;
+			dst_rects[i].y1 = src_rects[i].y1 * int_scale_y;
+			dst_rects[i].y2 = src_rects[i].y2 * int_scale_y;
+		}
+	} else {
+		for (int i = 0; i < nrects; ++i) {
+			dst_rects[i].x1 = floor(src_rects[i].x1 * scale_x);
+			dst_rects[i].x2 = ceil(src_rects[i].x2 * scale_x);
+			dst_rects[i].y1 = floor(src_rects[i].y1 * scale_y);
+			dst_rects[i].y2 = ceil(src_rects[i].y2 * scale_y);
+		}
 	}
 
-	pixman_region32_fini(dst);
-	pixman_region32_init_rects(dst, dst_rects, nrects);
-	free(dst_rects);
+	region_init_rects(dst, dst_rects, nrects, stack_rects);
+}
+
+/**
+ * Every transform is a combination of a swap of the axes followed by flips.
+ * This is inlined with constant arguments for each transform so that the loop
+ * is branchless and can be vectorized by the compiler.
+ */
+static inline void transform_rects(pixman_box32_t *dst_rects,
+		const pixman_box32_t *src_rects, int nrects,
+		bool swap, bool flip_x, bool flip_y, int width, int height) {
+	// Size of the region after swapping axes
+	int w = swap ? height : width;
+	int h = swap ? width : height;
+	for (int i = 0; i < nrects; ++i) {
+		const pixman_box32_t *src = &src_rects[i];
+		int32_t x1 = swap ? src->y1 : src->x1;
+		int32_t y1 = swap ? src->x1 : src->y1;
+		int32_t x2 = swap ? src->y2 : src->x2;
+		int32_t y2 = swap ? src->x2 : src->y2;
+
+		dst_rects[i].x1 = flip_x ? w - x2 : x1;
+		dst_rects[i].x2 = flip_x ? w - x1 : x2;
+		dst_rects[i].y1 = flip_y ? h - y2 : y1;
+		dst_rects[i].y2 = flip_y ? h - y1 : y2;
+	}
 }
 
 void wlr_region_transform(pixman_region32_t *dst, const pixman_region32_t *src,
@@ -46,67 +102,40 @@ void wlr_region_transform(pixman_region32_t *dst, const pixman_region32_t *src,
 	int nrects;
 	const pixman_box32_t *src_rects = pixman_region32_rectangles(src, &nrects);
 
-	pixman_box32_t *dst_rects = malloc(nrects * sizeof(pixman_box32_t));
+	pixman_box32_t stack_rects[STACK_RECTS_LEN];
+	pixman_box32_t *dst_rects = alloc_rects(stack_rects, nrects);
 	if (dst_rects == NULL) {
 		return;
 	}
 
-	for (int i = 0; i < nrects; ++i) {
-		switch (transform) {
-		case WL_OUTPUT_TRANSFORM_NORMAL:
-			dst_rects[i].x1 = src_rects[i].x1;
-			dst_rects[i].y1 = src_rects[i].y1;
-			dst_rects[i].x2 = src_rects[i].x2;
-			dst_rects[i].y2 = src_rects[i].y2;
-			break;
-		case WL_OUTPUT_TRANSFORM_90:
-			dst_rects[i].x1 = height - src_rects[i].y2;
-			dst_rects[i].y1 = src_rects[i].x1;
-			dst_rects[i].x2 = height - src_rects[i].y1;
-			dst_rects[i].y2 = src_rects[i].x2;
-			break;
-		case WL_OUTPUT_TRANSFORM_180:
-			dst_rects[i].x1 = width - src_rects[i].x2;
-			dst_rects[i].y1 = height - src_rects[i].y2;
-			dst_rects[i].x2 = width - src_rects[i].x1;
-			dst_rects[i].y2 = height - src_rects[i].y1;
-			break;
-		case WL_OUTPUT_TRANSFORM_270:
-			dst_rects[i].x1 = src_rects[i].y1;
-			dst_rects[i].y1 = width - src_rects[i].x2;
-			dst_rects[i].x2 = src_rects[i].y2;
-			dst_rects[i].y2 = width - src_rects[i].x1;
-			break;
-		case WL_OUTPUT_TRANSFORM_FLIPPED:
-			dst_rects[i].x1 = width - src_rects[i].x2;
-			dst_rects[i].y1 = src_rects[i].y1;
-			dst_rects[i].x2 = width - src_rects[i].x1;
-			dst_rects[i].y2 = src_rects[i].y2;
-			break;
-		case WL_OUTPUT_TRANSFORM_FLIPPED_90:
-			dst_rects[i].x1 = src_rects[i].y1;
-			dst_rects[i].y1 = src_rects[i].x1;
-			dst_rects[i].x2 = src_rects[i].y2;
-			dst_rects[i].y2 = src_rects[i].x2;
-			break;
-		case WL_OUTPUT_TRANSFORM_FLIPPED_180:
-			dst_rects[i].x1 = src_rects[i].x1;
-			dst_rects[i].y1 = height - src_rects[i].y2;
-			dst_rects[i].x2 = src_rects[i].x2;
-			dst_rects[i].y2 = height - src_rects[i].y1;
-			break;
-		case WL_OUTPUT_TRANSFORM_FLIPPED_270:
-			dst_rects[i].x1 = height - src_rects[i].y2;
-			dst_rects[i].y1 = width - src_rects[i].x2;
-			dst_rects[i].x2 = height - src_rects[i].y1;
-			dst_rects[i].y2 = width - src_rects[i].x1;
-			break;
-		}
+	switch (transform) {
+	case WL_OUTPUT_TRANSFORM_NORMAL:
+		transform_rects(dst_rects, src_rects, nrects, false, false, false, width, height);
+		break;
+	case WL_OUTPUT_TRANSFORM_90:
+		transform_rects(dst_rects, src_rects, nrects, true, true, false, width, height);
+		break;
+	case WL_OUTPUT_TRANSFORM_180:
+		transform_rects(dst_rects, src_rects, nrects, false, true, true, width, height);
+		break;
+	case WL_OUTPUT_TRANSFORM_270:
+		transform_rects(dst_rects, src_rects, nrects, true, false, true, width, height);
+		break;
+	case WL_OUTPUT_TRANSFORM_FLIPPED:
+		transform_rects(dst_rects, src_rects, nrects, false, true, false, width, height);
+		break;
+	case WL_OUTPUT_TRANSFORM_FLIPPED_90:
+		transform_rects(dst_rects, src_rects, nrects, true, false, false, width, height);
+		break;
+	case WL_OUTPUT_TRANSFORM_FLIPPED_180:
+		transform_rects(dst_rects, src_rects, nrects, false, false, true, width, height);
+		break;
+	case WL_OUTPUT_TRANSFORM_FLIPPED_270:
+		transform_rects(dst_rects, src_rects, nrects, true, true, true, width, height);
+		break;
 	}
 
-	pixman_region32_fini(dst);
-	pixman_region32_init_rects(dst, dst_rects, nrects);
-	free(dst_rects);
+	region_init_rects(dst, dst_rects, nrects, stack_rects);
 }
 
 void wlr_region_expand(pixman_region32_t *dst, const pixman_region32_t *src,
@@ -121,7 +150,8 @@ void wlr_region_expand(pixman_region32_t *dst, const pixman_region32_t *src,
 	int nrects;
 	const pixman_box32_t *src_rects = pixman_region32_rectangles(src, &nrects);
 
-	pixman_box32_t *dst_rects = malloc(nrects * sizeof(pixman_box32_t));
+	pixman_box32_t stack_rects[STACK_RECTS_LEN];
+	pixman_box32_t *dst_rects = alloc_rects(stack_rects, nrects);
 	if (dst_rects == NULL) {
 		return;
 	}
@@ -133,9 +163,7 @@ void wlr_region_expand(pixman_region32_t *dst, const pixman_region32_t *src,
 		dst_rects[i].y2 = src_rects[i].y2 + distance;
 	}
 
-	pixman_region32_fini(dst);
-	pixman_region32_init_rects(dst, dst_rects, nrects);
-	free(dst_rects);
+	region_init_rects(dst, dst_rects, nrects, stack_rects);
 }
 
 void wlr_region_rotated_bounds(pixman_region32_t *dst, const pixman_region32_t *src,
@@ -148,7 +176,8 @@ void wlr_region_rotated_bounds(pixman_region32_t *dst, const pixman_region32_t *
 	int nrects;
 	const pixman_box32_t *src_rects = pixman_region32_rectangles(src, &nrects);
 
-	pixman_box32_t *dst_rects = malloc(nrects * sizeof(pixman_box32_t));
+	pixman_box32_t stack_rects[STACK_RECTS_LEN];
+	pixman_box32_t *dst_rects = alloc_rects(stack_rects, nrects);
 	if (dst_rects == NULL) {
 		return;
 	}
@@ -182,9 +211,7 @@ void wlr_region_rotated_bounds(pixman_region32_t *dst, const pixman_region32_t *
 		dst_rects[i].y2 = ceil(oy + y2);
 	}
 
-	pixman_region32_fini(dst);
-	pixman_region32_init_rects(dst, dst_rects, nrects);
-	free(dst_rects);
+	region_init_rects(dst, dst_rects, nrects, stack_rects);
 }
 
 static void region_confine(const pixman_region32_t *region, double x1, double y1, double x2,
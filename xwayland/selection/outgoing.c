@@ -1,4 +1,6 @@
+#define _GNU_SOURCE // for F_SETPIPE_SZ
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
@@ -71,35 +73,45 @@ static int xwm_data_source_read(int fd, uint32_t mask, void *data) {
 	struct wlr_xwm_selection_transfer *transfer = data;
 	struct wlr_xwm *xwm = transfer->selection->xwm;
 
-	void *p;
+	// Never buffer more than one chunk, the rest stays in the pipe until the
+	// requestor has consumed the current one
+	size_t chunk_size = transfer->chunk_size;
 	size_t current = transfer->source_data.size;
-	if (transfer->source_data.size < INCR_CHUNK_SIZE) {
-		p = wl_array_add(&transfer->source_data, INCR_CHUNK_SIZE);
-		if (p == NULL) {
+	if (transfer->source_data.alloc < chunk_size) {
+		if (wl_array_add(&transfer->source_data, chunk_size - current) == NULL) {
 			wlr_log(WLR_ERROR, "Could not allocate selection source_data");
 			goto error_out;
 		}
-	} else {
-		p = (char *)transfer->source_data.data + transfer->source_data.size;
+		transfer->source_data.size = current;
 	}
 
-	size_t available = transfer->source_data.alloc - current;
-	ssize_t len = read(fd, p, available);
-	if (len == -1) {
-		wlr_log_errno(WLR_ERROR, "read error from data source");
-		goto error_out;
+	// Drain the pipe in one go to avoid a wakeup per pipe buffer
+	ssize_t len = -1;
+	while (transfer->source_data.size < chunk_size) {
+		char *p = (char *)transfer->source_data.data + transfer->source_data.size;
+		len = read(fd, p, chunk_size - transfer->source_data.size);
+		if (len == -1 && errno == EINTR) {
+			continue;
+		} else if (len == -1 && errno == EAGAIN) {
+			break;
+		} else if (len == -1) {
+			wlr_log_errno(WLR_ERROR, "read error from data source");
+			goto error_out;
+		} else if (len == 0) {
+			break;
+		}
+		transfer->source_data.size += len;
 	}
 
-	wlr_log(WLR_DEBUG, "read %zd bytes (available %zu, mask 0x%x)", len,
-		available, mask);
+	wlr_log(WLR_DEBUG, "read %zu bytes (chunk size %zu, mask 0x%x)",
+		transfer->source_data.size - current, chunk_size, mask);
 
-	transfer->source_data.size = current + len;
-	if (transfer->source_data.size >= INCR_CHUNK_SIZE) {
+	if (transfer->source_data.size >= chunk_size) {
 		if (!transfer->incr) {
 			wlr_log(WLR_DEBUG, "got %zu bytes, starting incr",
 				transfer->source_data.size);
 
-			size_t incr_chunk_size = INCR_CHUNK_SIZE;
+			uint32_t incr_chunk_size = chunk_size;
 			xcb_change_property(xwm->xcb_conn,
 				XCB_PROP_MODE_REPLACE,
 				transfer->request.requestor,
@@ -164,6 +176,13 @@ void xwm_send_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
 		transfer->flush_property_on_delete = false;
 		int length = xwm_selection_flush_source_data(transfer);
 
+		// The requestor keeps up, use bigger chunks to save round-trips
+		size_t max_chunk_size = transfer->selection->xwm->max_incr_chunk_size;
+		transfer->chunk_size *= 2;
+		if (transfer->chunk_size > max_chunk_size) {
+			transfer->chunk_size = max_chunk_size;
+		}
+
 		if (transfer->wl_client_fd >= 0) {
 			xwm_selection_transfer_start_outgoing(transfer);
 		} else if (length > 0) {
@@ -278,6 +297,7 @@ static bool xwm_selection_send_data(struct wlr_xwm_selection *selection,
 
 	xwm_selection_transfer_init(transfer, selection);
 	transfer->request = *req;
+	transfer->chunk_size = INCR_CHUNK_SIZE;
 	wl_array_init(&transfer->source_data);
 
 	int p[2];
@@ -291,6 +311,12 @@ static bool xwm_selection_send_data(struct wlr_xwm_selection *selection,
 	fcntl(p[1], F_SETFD, FD_CLOEXEC);
 	fcntl(p[1], F_SETFL, O_NONBLOCK);
 
+#ifdef F_SETPIPE_SZ
+	// Let the source write a whole chunk before we need to wake up. This is
+	// best-effort, the kernel may cap the size.
+	fcntl(p[0], F_SETPIPE_SZ, (int)selection->xwm->max_incr_chunk_size);
+#endif
+
 	transfer->wl_client_fd = p[0];
 
 	wlr_log(WLR_DEBUG, "Sending Wayland selection %u to Xwayland window with "
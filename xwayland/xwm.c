@@ -2162,6 +2162,7 @@ static void xwm_get_resources(struct wlr_xwm *xwm) {
 	xcb_prefetch_extension_data(xwm->xcb_conn, &xcb_xfixes_id);
 	xcb_prefetch_extension_data(xwm->xcb_conn, &xcb_composite_id);
 	xcb_prefetch_extension_data(xwm->xcb_conn, &xcb_res_id);
+	xcb_prefetch_maximum_request_length(xwm->xcb_conn);
 
 	size_t i;
 	xcb_intern_atom_cookie_t cookies[ATOM_LAST];
@@ -2170,6 +2171,19 @@ static void xwm_get_resources(struct wlr_xwm *xwm) {
 		cookies[i] =
 			xcb_intern_atom(xwm->xcb_conn, 0, strlen(atom_map[i]), atom_map[i]);
 	}
+
+	// Leave room for the ChangeProperty request header, which is larger
+	// when BIG-REQUESTS is in use
+	size_t max_request_size =
+		(size_t)xcb_get_maximum_request_length(xwm->xcb_conn) * 4;
+	xwm->max_incr_chunk_size = INCR_CHUNK_SIZE;
+	if (max_request_size > INCR_CHUNK_SIZE + 32) {
+		xwm->max_incr_chunk_size = max_request_size - 32;
+	}
+	if (xwm->max_incr_chunk_size > INCR_MAX_CHUNK_SIZE) {
+		xwm->max_incr_chunk_size = INCR_MAX_CHUNK_SIZE;
+	}
+
 	for (i = 0; i < ATOM_LAST; i++) {
 		xcb_generic_error_t *error;
 		xcb_intern_atom_reply_t *reply =